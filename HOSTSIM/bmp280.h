@@ -0,0 +1,3 @@
+//
+// HOSTSIM stand-in for the PicOS header bmp280.h (nothing needed)
+//
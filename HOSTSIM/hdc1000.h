@@ -0,0 +1,3 @@
+//
+// HOSTSIM stand-in for the PicOS header hdc1000.h (nothing needed)
+//
@@ -0,0 +1,919 @@
+/*
+	Copyright 2002-2021 (C) Olsonet Communications Corporation
+	Programmed by Pawel Gburzynski
+	All rights reserved
+
+	This file is part of the PICOS platform
+
+*/
+
+//
+// Host harness for the streaming protocol: the train/ACK code of the Tag
+// (streaming.cc) and the Peg (pegstream.cc) compiled natively against the
+// stand-in headers in this directory, driven by a discrete-event loop with
+// a simulated channel (loss, duplication, reordering, outages).
+//
+// Build:	g++ -O2 -I. -o hostsim hostsim.cc	(in HOSTSIM)
+// Usage:	hostsim [options]
+//
+//	-n blocks	number of blocks to generate (20000)
+//	-r rate		blocks generated per second (20)
+//	-l p		loss rate of Tag -> Peg packets (cars, EOTs)
+//	-a p		loss rate of ACKs
+//	-g gb:bg:p	bursty (Gilbert-Elliott) loss: the probabilities of the
+//			good->bad and bad->good transitions per packet and the
+//			loss rate (all packets) in the bad state
+//	-u p		duplication rate (all packets)
+//	-j msec		reordering: random extra delay up to msec
+//	-o from:len	an outage (msecs), can be repeated
+//	-t n		train length (STRM_TRAIN_LENGTH)
+//	-q n		max queued blocks (STRM_MAX_QUEUED)
+//	-c msec		car space (STRM_CAR_SPACE)
+//	-s msec		min train space (STRM_MIN_TRAIN_SPACE)
+//	-k n		codes per car (STRM_NCODES ... STRM_MAX_NCODES)
+//	-b bps		bit rate for the airtime of cars (50000, 0 == none)
+//	-w c:n:k	TDMA: a coordinator's beacon every c msecs (lost as
+//			ACKs), n slots, the Tag's slot is k (0 ... n-1)
+//	-y msec		sync beacons (no TDMA) every msec
+//	-S seed		random seed (1)
+//
+// Without -n, -r, -l, -a, -g, -u, -j, -o, a set of standard scenarios is run.
+// Every run checks that each generated block is delivered to the OSS side
+// intact and (after removing duplicates) exactly once, except for the blocks
+// dropped from the Tag's queue, and reports the throughput, the latency
+// (from generation to the first delivery), the peak queue size, and the ACK
+// statistics. The exit code is 1 if any check fails. As trains are only
+// closed when full, padding blocks follow the generated ones until all of
+// those have been acknowledged. A car takes the channel for its airtime
+// (the packet plus the PHY overhead at the bit rate), so the cars of a train
+// are spaced by car_space or the airtime, whichever is longer. With TDMA,
+// every car and EOT is checked to be sent (and end) within the Tag's slot
+// (the check fails if it isn't, unless STRM_TDMA_LOST beacons in a row have
+// been lost). With beacons (-w or -y), whose clock is offset at random from
+// the Tag's, the time sync mapping of every EOT is checked to put its block
+// within 1 msec of the block's generation time.
+//
+
+#include "../streaming.cc"
+#include "../pegstream.cc"
+
+#include <cstdio>
+#include <vector>
+#include <queue>
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+
+typedef	unsigned long long	u64;
+
+// The size of a queued block on the node (32-bit pointers)
+#define	NODE_BLKSIZE	(strblk_size (NCodes) - sizeof (strblk_t*) + 4)
+
+// PHY overhead per packet (preamble, sync, length, CRC), bytes
+#define	AIR_OVERHEAD	10
+
+// ============================================================================
+// What the rest of the Tag and Peg would provide
+// ============================================================================
+
+lword		host_id;
+byte		Status = STATUS_STREAMING;
+word		Voltage = 0x63 << 3;
+word		SamplesPerMinute;
+lword		SamplesTaken;
+word		loss_count;
+stream_stats_t	StreamStats;
+tag_params_t	TagParams;
+
+address osscmn_xpkt (byte code, byte ref, word len) {
+
+	address msg;
+
+	if (len & 1)
+		len++;
+	if ((msg = tcv_wnp (WNONE, RFC, len + PKT_FRAME_ALL)) != NULL) {
+		pkt_osshdr (msg) -> code = code;
+		pkt_osshdr (msg) -> ref = ref;
+	}
+	return msg;
+}
+
+// ============================================================================
+// Scenario
+// ============================================================================
+
+struct outage_t {
+	u64	from, upto;		// usecs
+};
+
+struct scenario_t {
+	const char	*name;
+	lword		nblocks;
+	double		rate, loss, aloss, dup, jitter, gb, bg, bloss;
+	std::vector<outage_t> outages;
+	tag_params_t	tp;
+	word		ncodes;
+	lword		bitrate;
+	word		cycle, slots, slot;	// TDMA, cycle == 0 -> none
+	word		sync;			// Sync beacons, 0 -> none
+};
+
+// ============================================================================
+// Events
+// ============================================================================
+
+#define	EV_GEN		0		// Generate a block
+#define	EV_SEND		1		// Train sender's timer
+#define	EV_TOPEG	2		// Packet arriving at the Peg
+#define	EV_TOTAG	3		// ACK arriving at the Tag
+#define	EV_BEACON	4		// TDMA/sync beacon
+
+struct event_t {
+	u64		t;		// usecs
+	u64		seq;
+	int		type;
+	u64		tok;		// for EV_SEND
+	std::vector<byte> *pkt;
+	bool operator< (const event_t &e) const {
+		// for the priority queue (the earliest first)
+		return t != e.t ? t > e.t : seq > e.seq;
+	}
+};
+
+static	std::priority_queue<event_t> EVQ;
+static	u64	NOW, SEQ;
+
+// Train sender (the FSM of streaming.cc)
+#define	TS_NEWTRAIN	0
+#define	TS_NEXT		1
+#define	TS_ENDTRAIN	2
+
+static	int	TS_STATE;
+static	word	TS_SPACE;
+static	u64	TS_TOK;
+
+// Packets issued by the code under test (the ACKs)
+static	std::vector<address> OUTQ;
+
+// Results
+struct result_t {
+	u64	cars, eots, acks, ackr, ackbytes, ackmax, ackfull, dups,
+		corrupt, delivered, missing, qdrops, ploss, t_end, events,
+		qpeak, beacons, blost, brun, oslot, syncs, serr;
+	double	wall, lmean, l95, lmax;		// latency (msecs)
+};
+
+static	result_t R;
+static	std::vector<byte> DLV;		// delivery count per block
+static	std::vector<u64> GTM;		// generation time per block
+static	std::vector<double> LAT;	// latency per delivered block
+static	const scenario_t *SC;
+
+static	unsigned int RSEED;
+static	bool	GEBAD;
+
+// Beacon departure and TDMA slot boundaries (from the departure), usecs
+static	u64	TBSENT, TW0, TW1, TCYC;
+
+// The coordinator's clock minus the Tag's, ticks
+static	lword	TPOFF;
+
+static double rnd01 () {
+
+	RSEED = RSEED * 1103515245 + 12345;
+	return (double)((RSEED >> 8) & 0xffffff) / (double) 0x1000000;
+}
+
+// ============================================================================
+// Stand-ins for the PicOS functions (see sysio.h)
+// ============================================================================
+
+address hostsim_malloc (word s) {
+
+	return (address) malloc (s);
+}
+
+void hostsim_free (void *p) {
+
+	free (p);
+}
+
+address hostsim_wnp (word len) {
+//
+// The length is kept in front of the packet (as tcv_left would know it)
+//
+	word *p = (word*) calloc (1, len + 2 + 8);
+
+	*p = len;
+	return p + 1;
+}
+
+static word pkt_len (address p) {
+
+	return p [-1];
+}
+
+static void pkt_free (address p) {
+
+	free (p - 1);
+}
+
+void hostsim_endp (address p) {
+
+	OUTQ . push_back (p);
+}
+
+lword hostsim_ticks () {
+
+	return (lword)((NOW * 65536) / 1000000);
+}
+
+static void schedule (u64 t, int type, std::vector<byte> *pkt = NULL,
+								u64 tok = 0) {
+	event_t e;
+
+	e . t = t;
+	e . seq = SEQ++;
+	e . type = type;
+	e . tok = tok;
+	e . pkt = pkt;
+	EVQ . push (e);
+}
+
+void hostsim_trigger () {
+//
+// ptrigger (TSender): wakes up the sender if it is waiting for it
+//
+	if ((TS_STATE == TS_NEXT && TSStat == STRM_TSSTAT_WDAT) ||
+	    TS_STATE == TS_ENDTRAIN)
+		schedule (NOW, EV_SEND, NULL, ++TS_TOK);
+}
+
+// ============================================================================
+// The channel
+// ============================================================================
+
+static bool outage (u64 t) {
+
+	for (size_t i = 0; i < SC -> outages . size (); i++)
+		if (t >= SC -> outages [i] . from && t < SC -> outages [i] . upto)
+			return true;
+	return false;
+}
+
+static bool transmit (address p, int type, double loss, bool timed = false) {
+//
+// Send a packet (consumed) over the channel: type is EV_TOPEG or EV_TOTAG;
+// returns false if lost; timed packets (the beacons) are not reordered
+//
+	int n, k;
+
+	if (SC -> gb > 0.0) {
+		// Gilbert-Elliott channel (shared by both directions)
+		if (rnd01 () < (GEBAD ? SC -> bg : SC -> gb))
+			GEBAD = !GEBAD;
+		if (GEBAD)
+			loss = SC -> bloss;
+	}
+
+	n = (outage (NOW) || rnd01 () < loss) ? 0 :
+		(rnd01 () < SC -> dup ? 2 : 1);
+
+	for (k = n; k--; ) {
+		std::vector<byte> *c = new std::vector<byte> ((byte*) p,
+			(byte*) p + pkt_len (p));
+		schedule (NOW + 2000 + (timed ? 0 :
+			(u64)(rnd01 () * SC -> jitter * 1000.0)), type, c);
+	}
+
+	pkt_free (p);
+	return n != 0;
+}
+
+// ============================================================================
+// The Tag
+// ============================================================================
+
+static lword pattern (lword bn, int i) {
+//
+// Block contents (the two bits for the block number are left clear)
+//
+	lword c = (bn * 2654435761u) ^ ((lword) i * 40503u);
+
+	return (c ^ (c >> 15)) & ~(lword) 3;
+}
+
+static void generate () {
+
+	if ((CBuilt = (strblk_t*) umalloc (strblk_size (NCodes))) == NULL)
+		return;
+	for (int i = 0; i < NCodes; i++)
+		CBuilt -> block [i] = pattern (LastGenerated + 1, i);
+	add_current ();
+	// The samples of the block are all taken now
+	sync_mark (0, NCodes);
+
+	if (LastGenerated < GTM . size ())
+		GTM [LastGenerated] = NOW;
+	if (NQueued > R . qpeak)
+		R . qpeak = NQueued;
+}
+
+static u64 airtime (word len) {
+//
+// Usecs to transmit a packet of len bytes
+//
+	if (SC -> bitrate == 0)
+		return 0;
+	return ((u64)(len + AIR_OVERHEAD) * 8 * 1000000) / SC -> bitrate;
+}
+
+static void in_slot (u64 d) {
+//
+// Check that a transmission of d usecs starting now falls within the slot
+// of the Tag (relative to the last beacon sent); the beacons are periodic,
+// so the ones lost don't matter, unless the Tag has given up on them
+//
+	u64 p;
+
+	if (SC -> cycle == 0 || TBSENT == 0 || R . brun >= STRM_TDMA_LOST - 1)
+		return;
+
+	p = (NOW - TBSENT) % TCYC;
+	if (p < TW0 || p + d > TW1)
+		R . oslot++;
+}
+
+static void sender () {
+//
+// The train sender FSM of streaming.cc
+//
+	address pkt;
+	u64 d;
+	word w;
+
+	while (1) {
+		switch (TS_STATE) {
+
+		    case TS_NEWTRAIN:
+
+			train_start ();
+			TS_STATE = TS_NEXT;
+			// fall through
+
+		    case TS_NEXT:
+
+			w = tdma_wait (STRM_TDMA_TAIL);
+
+			if (NCars >= TRAIN_LENGTH || (NCars && w)) {
+				TSStat = STRM_TSSTAT_WACK;
+				TS_SPACE = TagParams.min_train_space;
+				TS_STATE = TS_ENDTRAIN;
+				continue;
+			}
+
+			if (w) {
+				schedule (NOW + w * 1000, EV_SEND, NULL,
+					++TS_TOK);
+				return;
+			}
+
+			if (CCar == NULL) {
+				TSStat = STRM_TSSTAT_WDAT;
+				if ((w = tdma_left (STRM_TDMA_TAIL)) != WNONE)
+					schedule (NOW + w * 1000, EV_SEND, NULL,
+						++TS_TOK);
+				return;
+			}
+
+			TSStat = STRM_TSSTAT_NONE;
+			pkt = tcv_wnp (TS_NEXT, RFC, NCodes * 4 +
+				PKT_FRAME_ALL);
+			fill_current_car (pkt);
+			// The radio is busy for the airtime
+			in_slot (airtime (pkt_len (pkt)));
+			if ((d = airtime (pkt_len (pkt))) <
+			    TagParams.car_space * 1000)
+				d = TagParams.car_space * 1000;
+			transmit (pkt, EV_TOPEG, SC -> loss);
+			R . cars++;
+			train_next ();
+			schedule (NOW + d, EV_SEND, NULL, ++TS_TOK);
+			return;
+
+		    default:
+
+			if (TSStat != STRM_TSSTAT_WACK) {
+				TS_STATE = TS_NEWTRAIN;
+				continue;
+			}
+
+			if ((w = tdma_wait (STRM_TDMA_ETAIL)) != 0) {
+				schedule (NOW + w * 1000, EV_SEND, NULL,
+					++TS_TOK);
+				return;
+			}
+
+			pkt = tcv_wnp (TS_ENDTRAIN, RFC,
+				sizeof (message_etrain_t) + PKT_FRAME_ALL);
+			fill_eot (pkt);
+			in_slot (airtime (pkt_len (pkt)));
+			transmit (pkt, EV_TOPEG, SC -> loss);
+			R . eots++;
+			schedule (NOW + TS_SPACE * 1000, EV_SEND, NULL,
+				++TS_TOK);
+			if (TS_SPACE < STRM_MAX_TRAIN_SPACE)
+				TS_SPACE++;
+			return;
+		}
+	}
+}
+
+static void tag_receive (std::vector<byte> *c) {
+
+	address p = (address) c -> data ();
+	word mpl = (word) c -> size () - PKT_FRAME_ALL;
+
+	if (pkt_osshdr (p) -> code == MESSAGE_CODE_BEACON) {
+		R . brun = 0;
+		streaming_beacon (pkt_osshdr (p) -> ref, pkt_payload (p), mpl);
+		return;
+	}
+
+	R . ackr++;
+	streaming_tack (pkt_osshdr (p) -> ref, (byte*) pkt_payload (p), mpl);
+}
+
+static void beacon () {
+//
+// The coordinator (pegstream.cc); the beacons are lost like ACKs
+//
+	address pkt;
+
+	if ((pkt = pegstream_beacon ()) == NULL)
+		return;
+
+	// The coordinator's own clock
+	((strbcn_t*) pkt_payload (pkt)) -> clock += TPOFF;
+
+	TBSENT = NOW;
+	R . beacons++;
+	if (!transmit (pkt, EV_TOTAG, SC -> aloss, true)) {
+		// The run of lost ones ends when the Tag receives one
+		R . blost++;
+		R . brun++;
+	}
+	schedule (NOW + TCYC, EV_BEACON);
+}
+
+static void coord_setup (const scenario_t *sc) {
+//
+// The Tag's group is 1, the other slots belong to groups 2, 3, ...
+//
+	byte gl [STRM_TDMA_MAX_SLOTS * 2];
+	word i, g;
+
+	host_id = 0x00010001;
+	TBSENT = 0;
+	pegstream_tdma (0, NULL, 0);
+	TSlotted = NO;
+	SyncOn = NO;
+	TPOFF = sc -> cycle || sc -> sync ?
+		(lword)(rnd01 () * 4294967296.0) : 0;
+
+	if (pegstream_sync (sc -> sync) != ACK_OK) {
+		fprintf (stderr, "illegal sync interval, must be %u to %u "
+			"msecs\n", STRM_SYNC_MIN, STRM_SYNC_MAX);
+		exit (2);
+	}
+	TCYC = ((u64) sc -> sync * 1000000) / 1024;
+
+	if (sc -> cycle == 0)
+		return;
+
+	for (g = 2, i = 0; i < sc -> slots; i++) {
+		gl [i + i] = (byte)(i == sc -> slot ? 1 : g++);
+		gl [i + i + 1] = 0;
+	}
+
+	if (pegstream_tdma (sc -> cycle, gl, sc -> slots * 2) != ACK_OK) {
+		fprintf (stderr, "illegal TDMA schedule, the slots are too "
+			"short\n");
+		exit (2);
+	}
+
+	// The slot boundaries after the beacon's departure (which reaches
+	// the Tag 2 msecs later), the msecs are 1/1024 s
+	TCYC = ((u64) Schedule . cycle * 1000000) / 1024;
+	TW0 = 2000 + ((u64)(STRM_TDMA_GUARD + Schedule . slot * sc -> slot) *
+		1000000) / 1024;
+	TW1 = TW0 + ((u64) Schedule . slot * 1000000) / 1024;
+}
+
+// ============================================================================
+// The Peg and the OSS
+// ============================================================================
+
+static void sink (byte ref, address pay) {
+//
+// The block as received by the OSS
+//
+	lword bn, *c = (lword*) pay;
+	int i;
+
+	for (bn = ref, i = 0; i < STRM_NCODES; i++)
+		bn |= (c [i] & 0x3) << (i + i + 8);
+
+	if (bn == 0 || bn > LastGenerated) {
+		R . corrupt++;
+		return;
+	}
+
+	for (i = 0; i < NCodes; i++) {
+		if ((c [i] & ~(lword) 3) != pattern (bn, i)) {
+			R . corrupt++;
+			return;
+		}
+	}
+
+	if (bn > SC -> nblocks)
+		// Padding
+		return;
+
+	if (DLV [bn]++) {
+		R . dups++;
+	} else {
+		R . delivered++;
+		LAT . push_back ((NOW - GTM [bn]) / 1000.0);
+	}
+}
+
+static void sync_check (const message_etrain_t *m) {
+//
+// The time of the EOT's sync block (whose samples were all taken when it
+// was generated) on the Tag's clock vs the generation time; the beacons
+// reach the Tag 2 msecs after the clock is stamped (the same for all Tags)
+//
+	u64 t;
+
+	if (!(m -> flags & STRM_TFLAG_SYN) || m -> sblock > SC -> nblocks)
+		return;
+
+	R . syncs++;
+	t = ((u64)(lword)(m -> sclock - TPOFF) * 1000000) / 65536 + 2000;
+	t = t > GTM [m -> sblock] ? t - GTM [m -> sblock] :
+		GTM [m -> sblock] - t;
+	if (t > R . serr)
+		R . serr = t;
+}
+
+static void peg_receive (std::vector<byte> *c) {
+
+	address p = (address) c -> data (), ack;
+	word mpl = (word) c -> size () - PKT_FRAME_ALL;
+	byte code = pkt_osshdr (p) -> code, ref = pkt_osshdr (p) -> ref;
+
+	if (code == MESSAGE_CODE_SBLOCK) {
+		pegstream_tally_block (ref, pkt_payload (p));
+		sink (ref, pkt_payload (p));
+		return;
+	}
+
+	// EOT
+	sync_check ((message_etrain_t*) pkt_payload (p));
+	pegstream_eot (ref, pkt_payload (p));
+	R . ploss += loss_count;
+	loss_count = 0;
+
+	while (!OUTQ . empty ()) {
+		ack = OUTQ . back ();
+		OUTQ . pop_back ();
+		mpl = pkt_len (ack) - PKT_FRAME_ALL;
+		R . acks++;
+		R . ackbytes += mpl;
+		if (mpl > R . ackmax)
+			R . ackmax = mpl;
+		if (mpl >= STRM_MAX_ACKPAY)
+			R . ackfull++;
+		transmit (ack, EV_TOTAG, SC -> aloss);
+	}
+}
+
+// ============================================================================
+
+static bool drained (const scenario_t *sc) {
+//
+// All blocks up to nblocks acknowledged (or dropped)
+//
+	return LastGenerated >= sc -> nblocks &&
+		(BHead == NULL || BHead -> bn > sc -> nblocks);
+}
+
+static bool run (const scenario_t *sc) {
+
+	event_t e;
+	u64 gi, gen, tlimit;
+	clock_t wc;
+	bool ok;
+
+	SC = sc;
+	memset (&R, 0, sizeof (R));
+	GEBAD = false;
+	DLV . assign (sc -> nblocks + 1, 0);
+	GTM . assign (sc -> nblocks + 1, 0);
+	LAT . clear ();
+	while (!EVQ . empty ())
+		EVQ . pop ();
+
+	// Reset the Tag and the Peg
+	while (BHead)
+		delete_front ();
+	CCar = CBuilt = NULL;
+	NQueued = NCars = 0;
+	LastSent = LastGenerated = 0;
+	LTrain = 0;
+	TSStat = STRM_TSSTAT_NONE;
+	TS_STATE = TS_NEWTRAIN;
+	TagParams = sc -> tp;
+	NCodes = sc -> ncodes;
+	memset (&StreamStats, 0, sizeof (StreamStats));
+	pegstream_init ();
+	coord_setup (sc);
+
+	NOW = SEQ = 0;
+	gi = (u64)(1000000.0 / sc -> rate);
+	gen = 0;
+	// Give up after that much time past the generation period
+	tlimit = gi * sc -> nblocks + 120000000ULL;
+
+	wc = clock ();
+
+	schedule (0, EV_GEN);
+	schedule (0, EV_SEND, NULL, ++TS_TOK);
+	if (pegstream_coordinating ())
+		schedule (0, EV_BEACON);
+
+	while (!EVQ . empty ()) {
+		e = EVQ . top ();
+		EVQ . pop ();
+		if ((NOW = e . t) > tlimit)
+			break;
+		R . events++;
+		switch (e . type) {
+		    case EV_GEN:
+			// Past nblocks, keep generating padding to complete the
+			// trains (they are only closed when full)
+			if (gen < sc -> nblocks || !drained (sc))
+				schedule (NOW + gi, EV_GEN);
+			generate ();
+			gen++;
+			break;
+		    case EV_SEND:
+			if (e . tok == TS_TOK)
+				sender ();
+			break;
+		    case EV_TOPEG:
+			peg_receive (e . pkt);
+			break;
+		    case EV_BEACON:
+			beacon ();
+			break;
+		    default:
+			tag_receive (e . pkt);
+		}
+		delete e . pkt;
+		if (gen >= sc -> nblocks && drained (sc))
+			// All acknowledged
+			break;
+	}
+
+	R . t_end = NOW;
+	R . wall = (double)(clock () - wc) / CLOCKS_PER_SEC;
+	R . qdrops = StreamStats . queue_drops;
+
+	while (!EVQ . empty ()) {
+		delete EVQ . top () . pkt;
+		EVQ . pop ();
+	}
+
+	for (lword i = 1; i <= sc -> nblocks; i++)
+		if (DLV [i] == 0)
+			R . missing++;
+
+	if (!LAT . empty ()) {
+		for (size_t i = 0; i < LAT . size (); i++)
+			R . lmean += LAT [i];
+		R . lmean /= LAT . size ();
+		std::sort (LAT . begin (), LAT . end ());
+		R . l95 = LAT [(LAT . size () * 95 - 1) / 100];
+		R . lmax = LAT . back ();
+	}
+
+	// A block can only be missing if it was dropped from the queue
+	ok = R . corrupt == 0 && R . missing <= R . qdrops &&
+		gen >= sc -> nblocks && drained (sc) && R . oslot == 0 &&
+		(!pegstream_coordinating () || (R . syncs && R . serr <= 1000));
+
+	printf ("%-20s %s\n", sc -> name, ok ? "OK" : "FAILED");
+	printf ("  delivered %llu/%u, missing %llu, queue drops %llu, "
+		"duplicates %llu, corrupt %llu%s\n",
+		R . delivered, sc -> nblocks, R . missing, R . qdrops, R . dups,
+		R . corrupt, drained (sc) ? "" : ", NOT DRAINED");
+	printf ("  cars %llu (%.3f per block), EOTs %llu, peg loss %llu\n",
+		R . cars, (double) R . cars / sc -> nblocks, R . eots,
+		R . ploss);
+	printf ("  ACKs %llu sent, %llu received, %.1f bytes mean, %llu max, "
+		"%llu full\n", R . acks, R . ackr,
+		R . acks ? (double) R . ackbytes / R . acks : 0.0, R . ackmax,
+		R . ackfull);
+	printf ("  latency %.1f ms mean, %.1f ms 95%%, %.1f ms max, "
+		"peak queue %llu blocks (%llu bytes)\n",
+		R . lmean, R . l95, R . lmax, R . qpeak,
+		R . qpeak * (u64) NODE_BLKSIZE);
+	printf ("  goodput %.2f blocks/s (offered %.2f), %u codes per car, "
+		"drained at %.3f s, %llu events, %.3f s wall\n",
+		R . t_end ? R . delivered * 1000000.0 / R . t_end : 0.0,
+		sc -> rate, NCodes, R . t_end / 1000000.0, R . events,
+		R . wall);
+	if (sc -> cycle)
+		printf ("  TDMA cycle %u ms, slot %u of %u (%u ms), beacons "
+			"%llu, lost %llu, out of slot %llu\n", sc -> cycle,
+			sc -> slot, sc -> slots, Schedule . slot, R . beacons,
+			R . blost, R . oslot);
+	if (pegstream_coordinating ())
+		printf ("  sync %llu EOTs, max error %.3f ms\n", R . syncs,
+			R . serr / 1000.0);
+
+	return ok;
+}
+
+// ============================================================================
+
+static void defaults (scenario_t &s) {
+
+	s . name = "custom";
+	s . nblocks = 20000;
+	s . rate = 20.0;
+	s . loss = s . aloss = s . dup = s . jitter = 0.0;
+	s . gb = s . bg = s . bloss = 0.0;
+	s . outages . clear ();
+	s . tp . train_length = STRM_TRAIN_LENGTH;
+	s . tp . max_queued = STRM_MAX_QUEUED;
+	s . tp . car_space = STRM_CAR_SPACE;
+	s . tp . min_train_space = STRM_MIN_TRAIN_SPACE;
+	s . tp . byte_error_rate = 0;
+	s . tp . byte_error_bad = 0;
+	s . tp . gb_transition = 0;
+	s . tp . bg_transition = 0;
+	s . ncodes = STRM_NCODES;
+	s . bitrate = 50000;
+	s . cycle = s . slots = s . slot = 0;
+	s . sync = 0;
+}
+
+static void bad_arg (const char *a) {
+
+	fprintf (stderr, "illegal argument %s\n", a);
+	exit (2);
+}
+
+static double darg (const char *a, double mn, double mx) {
+
+	char *e;
+	double d = strtod (a, &e);
+
+	if (*e != '\0' || d < mn || d > mx)
+		bad_arg (a);
+	return d;
+}
+
+int main (int argc, char *argv []) {
+
+	scenario_t s;
+	std::vector<scenario_t> sl;
+	bool custom = false, ok = true;
+	outage_t o;
+	char *e;
+
+	defaults (s);
+	RSEED = 1;
+
+	for (argc--, argv++; argc > 1; argc -= 2, argv += 2) {
+		if (argv [0][0] != '-' || argv [0][1] == '\0' ||
+		    argv [0][2] != '\0')
+			bad_arg (argv [0]);
+		switch (argv [0][1]) {
+		    case 'n': s . nblocks = (lword) darg (argv [1], 1, 1e8);
+			custom = true; break;
+		    case 'r': s . rate = darg (argv [1], 0.1, 1000.0);
+			custom = true; break;
+		    case 'l': s . loss = darg (argv [1], 0.0, 0.99);
+			custom = true; break;
+		    case 'a': s . aloss = darg (argv [1], 0.0, 0.99);
+			custom = true; break;
+		    case 'u': s . dup = darg (argv [1], 0.0, 1.0);
+			custom = true; break;
+		    case 'j': s . jitter = darg (argv [1], 0.0, 10000.0);
+			custom = true; break;
+		    case 'g':
+			if (sscanf (argv [1], "%lf:%lf:%lf", &s . gb, &s . bg,
+			    &s . bloss) != 3 || s . gb < 0.0 || s . gb > 1.0 ||
+			    s . bg <= 0.0 || s . bg > 1.0 || s . bloss < 0.0 ||
+			    s . bloss > 0.99)
+				bad_arg (argv [1]);
+			custom = true;
+			break;
+		    case 'o':
+			o . from = strtoull (argv [1], &e, 10) * 1000;
+			if (*e != ':')
+				bad_arg (argv [1]);
+			o . upto = o . from + strtoull (e + 1, &e, 10) * 1000;
+			if (*e != '\0')
+				bad_arg (argv [1]);
+			s . outages . push_back (o);
+			custom = true;
+			break;
+		    case 't': s . tp . train_length =
+			(word) darg (argv [1], 1, 1024); break;
+		    case 'q': s . tp . max_queued =
+			(word) darg (argv [1], 1, 65535); break;
+		    case 'c': s . tp . car_space =
+			(word) darg (argv [1], 0, 1024); break;
+		    case 's': s . tp . min_train_space =
+			(word) darg (argv [1], 1, STRM_MAX_TRAIN_SPACE); break;
+		    case 'k': s . ncodes = (word) darg (argv [1], STRM_NCODES,
+			STRM_MAX_NCODES); break;
+		    case 'b': s . bitrate = (lword) darg (argv [1], 0, 1e7);
+			break;
+		    case 'w':
+			if (sscanf (argv [1], "%hu:%hu:%hu", &s . cycle,
+			    &s . slots, &s . slot) != 3 || s . cycle == 0 ||
+			    s . slots == 0 || s . slots > STRM_TDMA_MAX_SLOTS ||
+			    s . slot >= s . slots)
+				bad_arg (argv [1]);
+			break;
+		    case 'y': s . sync = (word) darg (argv [1], STRM_SYNC_MIN,
+			STRM_SYNC_MAX); break;
+		    case 'S': RSEED = (unsigned int) darg (argv [1], 0, 4e9);
+			break;
+		    default:
+			bad_arg (argv [0]);
+		}
+	}
+
+	if (argc)
+		bad_arg (argv [0]);
+
+	if (custom) {
+		sl . push_back (s);
+	} else {
+		s . name = "clean";
+		sl . push_back (s);
+		s . name = "loss 5%";
+		s . loss = 0.05;
+		sl . push_back (s);
+		s . name = "loss 20%";
+		s . loss = 0.20;
+		sl . push_back (s);
+		s . name = "loss+dup+reorder";
+		s . loss = 0.10; s . dup = 0.05; s . jitter = 20.0;
+		sl . push_back (s);
+		s . name = "ACK loss 30%";
+		s . loss = 0.05; s . dup = 0.0; s . jitter = 0.0;
+		s . aloss = 0.30;
+		sl . push_back (s);
+		s . name = "outages";
+		s . aloss = 0.0;
+		o . from = 100000000; o . upto = o . from + 2000000;
+		s . outages . push_back (o);
+		o . from = 400000000; o . upto = o . from + 5000000;
+		s . outages . push_back (o);
+		sl . push_back (s);
+		s . name = "bursty";
+		s . outages . clear ();
+		s . loss = 0.02;
+		s . gb = 0.01; s . bg = 0.1; s . bloss = 0.8;
+		sl . push_back (s);
+		s . name = "overload";
+		s . gb = s . bg = s . bloss = 0.0;
+		s . outages . clear ();
+		s . loss = 0.40;
+		s . rate = 60.0;
+		sl . push_back (s);
+		s . name = "TDMA 2 slots";
+		s . loss = 0.05;
+		s . rate = 20.0;
+		s . cycle = 400; s . slots = 2; s . slot = 1;
+		sl . push_back (s);
+		s . name = "sync beacons";
+		s . cycle = s . slots = s . slot = 0;
+		s . sync = 1000;
+		sl . push_back (s);
+	}
+
+	for (size_t i = 0; i < sl . size (); i++)
+		if (!run (&sl [i]))
+			ok = false;
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,3 @@
+//
+// HOSTSIM stand-in for the PicOS header mpu9250.h (nothing needed)
+//
@@ -0,0 +1,3 @@
+//
+// HOSTSIM stand-in for the PicOS header opt3001.h (nothing needed)
+//
@@ -0,0 +1,3 @@
+//
+// HOSTSIM stand-in for the PicOS header phys_cc1350.h (nothing needed)
+//
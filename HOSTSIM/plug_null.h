@@ -0,0 +1,3 @@
+//
+// HOSTSIM stand-in for the PicOS header plug_null.h (nothing needed)
+//
@@ -0,0 +1,144 @@
+/*
+	Copyright 2002-2021 (C) Olsonet Communications Corporation
+	Programmed by Pawel Gburzynski
+	All rights reserved
+
+	This file is part of the PICOS platform
+
+*/
+
+//
+// Host check of the sampling rate corrector (rate_correct in sampling.cc):
+// the generator is modelled in PicOS msecs (1/1024 s) with a fixed per-sample
+// overhead on top of the delay, the corrector is called every correction
+// period with the marks the generator would leave, and the achieved count
+// must stay within a few samples of the target (counted from the reference
+// mark) after the first quarter of the run, with the space never pinned at
+// the maximum after the first correction.
+//
+// Build:	g++ -O2 -I. -o ratecheck ratecheck.cc	(in HOSTSIM)
+// Usage:	ratecheck
+//
+// The exit code is 1 if any check fails.
+//
+
+#include "../sampling.cc"
+
+#include <cstdio>
+
+// ============================================================================
+// What the rest of the Tag would provide
+// ============================================================================
+
+lword		host_id;
+byte		Status;
+
+struct rcase_t {
+	const char	*name;
+	word		spm;		// Samples per minute
+	word		overhead;	// Per-sample msecs outside the delay
+	word		minutes;	// Run time
+};
+
+static const rcase_t Cases [] = {
+	{ "1/s, 5 ms overhead",		60,	5,	30 },
+	{ "20/s, 20 ms overhead",	1200,	20,	30 },
+	{ "128/s, 1 ms overhead",	7680,	1,	10 },
+	{ "2/min, spaces above 32 s",	2,	3,	120 },
+	{ "1/min, no overhead",		1,	0,	240 },
+};
+
+static bool run (const rcase_t &c) {
+
+	lword t, tcorr, tend, s, target;
+	long dev, maxdev;
+	bool ok;
+	int ncorr;
+
+	// As in sampling_start
+	SamplesPerMinute = c . spm;
+	SampleSpace = ((lword)(60 * 1024) << 16) / SamplesPerMinute;
+	SamplePhase = 0;
+	SampleOverhead = 0;
+	SamplePeriod = (60 * CORR_SAMPLES) / SamplesPerMinute;
+	if (SamplePeriod < MIN_CORR_PERIOD)
+		SamplePeriod = MIN_CORR_PERIOD;
+	else if (SamplePeriod > MAX_CORR_PERIOD)
+		SamplePeriod = MAX_CORR_PERIOD;
+	SamplesTaken = 0;
+	SampleMarkSecond = SampleMarkCount = 0;
+	RefSecond = RefCount = CorrSecond = CorrCount = 0;
+
+	ok = true;
+	maxdev = 0;
+	ncorr = 0;
+	// The first sample is taken at once; start at second 1, so the
+	// first mark differs from the initial (zero) one
+	t = 1024;
+	tcorr = t + SamplePeriod * 1024;
+	tend = t + (lword) c . minutes * 60 * 1024;
+
+	while (t < tend) {
+		// SM_REPORT (the overhead is spent before the sample counts)
+		t += c . overhead;
+		SamplesTaken++;
+		if ((s = t / 1024) != SampleMarkSecond) {
+			SampleMarkSecond = s;
+			SampleMarkCount = SamplesTaken;
+		}
+		// SM_DELAY
+		SamplePhase += SampleSpace;
+		t += (word)(SamplePhase >> 16);
+		SamplePhase &= 0xffff;
+
+		while (tcorr <= t) {
+			rate_correct ();
+			tcorr += SamplePeriod * 1024;
+			if (++ncorr > 1 &&
+			    SampleSpace >= ((lword) MAX_SAMPLE_SPACE << 16)) {
+				printf ("  space pinned at the max after "
+					"correction %d\n", ncorr);
+				ok = false;
+			}
+		}
+
+		if (t - 1024 > (tend - 1024) / 4) {
+			// Settled, compare with the target since the reference
+			// mark (the corrector doesn't make up for the time
+			// before it)
+			target = RefCount + (lword)(((double)(t -
+				RefSecond * 1024) / (60 * 1024)) * c . spm);
+			dev = (long) SamplesTaken - (long) target;
+			if (dev < 0)
+				dev = -dev;
+			if (dev > maxdev)
+				maxdev = dev;
+		}
+	}
+
+	// Within two samples or 1% of a correction period's worth
+	if (maxdev > 2 + (long)((SamplePeriod * c . spm) / 6000)) {
+		printf ("  off target by %ld samples\n", maxdev);
+		ok = false;
+	}
+
+	printf ("%-28s %6lu samples, max deviation %ld, space %.3f ms, "
+		"error %d/100 spm %s\n", c . name, (unsigned long) SamplesTaken,
+		maxdev, (double) SampleSpace / 65536.0, SampleRateError,
+		ok ? "OK" : "FAILED");
+
+	return ok;
+}
+
+int main () {
+
+	bool ok;
+	unsigned i;
+
+	ok = true;
+	for (i = 0; i < sizeof (Cases) / sizeof (rcase_t); i++)
+		if (!run (Cases [i]))
+			ok = false;
+
+	return ok ? 0 : 1;
+}
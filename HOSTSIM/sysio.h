@@ -0,0 +1,64 @@
+/*
+	Copyright 2002-2021 (C) Olsonet Communications Corporation
+	Programmed by Pawel Gburzynski
+	All rights reserved
+
+	This file is part of the PICOS platform
+
+*/
+#ifndef	__pg_hostsim_sysio_h
+#define	__pg_hostsim_sysio_h
+
+//
+// HOSTSIM stand-in for the PicOS system header: just enough of the types
+// and the API for the protocol code of streaming.cc and pegstream.cc (and
+// the rate corrector of sampling.cc) to compile on the host; the FSMs are
+// excluded (by __HOSTSIM__) and the harness provides the functions declared
+// at the end
+//
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#define	__HOSTSIM__
+
+// The host has the RAM to model any car size (-k)
+#define	STREAM_BIG_CARS	1
+
+typedef	unsigned char	byte;
+typedef	uint16_t	word;
+typedef	uint32_t	lword;
+typedef	int		sint;
+typedef	int32_t		lint;
+typedef	intptr_t	aword;
+typedef	word		*address;
+typedef	int		Boolean;
+
+#define	YES		1
+#define	NO		0
+#define	NONE		(-1)
+#define	WNONE		((word)(-1))
+#define	CNOP		do { } while (0)
+
+// Only declarations of FSMs remain in the headers
+#define	fsm		extern int
+
+extern	lword		host_id;
+
+address	hostsim_malloc (word);
+void	hostsim_free (void*);
+void	hostsim_trigger ();
+address	hostsim_wnp (word);
+void	hostsim_endp (address);
+lword	hostsim_ticks ();
+
+#define	umalloc(s)		hostsim_malloc (s)
+#define	ufree(p)		hostsim_free (p)
+#define	ptrigger(a,b)		hostsim_trigger ()
+#define	tcv_wnp(s,d,l)		hostsim_wnp (l)
+#define	tcv_endp(p)		hostsim_endp (p)
+#define	strm_ticks()		hostsim_ticks ()
+
+#endif
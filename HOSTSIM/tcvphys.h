@@ -0,0 +1,3 @@
+//
+// HOSTSIM stand-in for the PicOS header tcvphys.h (nothing needed)
+//
@@ -0,0 +1,325 @@
+#!/usr/bin/env python3
+# _*_ coding: ascii _*_
+
+#
+# Streaming parameter tuner: sweeps the Tag's train parameters (TagParams:
+# train_length, max_queued, car_space, min_train_space) through the host
+# harness (hostsim) for a given block rate and loss profile, prints the
+# goodput/latency/RAM Pareto front and the recommended settings (to be
+# set with setp 0..3).
+#
+# Usage: tune.py [-r rate] [-l loss] [-a aloss] [-g gb:bg:p] [-t list]
+#		[-q list] [-c list] [-s list] [-k codes] [-w c:n:k]
+#		[-n blocks] [-S seeds] [-m bytes] [-j jobs] [-o csv]
+#		[-x hostsim]
+#
+# Lists are comma-separated values; combinations with max_queued below
+# train_length are skipped. The car size (-k, stream -codes) is fixed for
+# the sweep; the rate is in blocks (cars) per second. With -w, the Tag
+# streams in slot k of n of a TDMA cycle of c msecs (see hostsim).
+#
+
+import os
+import sys
+import re
+import subprocess
+import itertools
+import argparse
+
+###############################################################################
+
+def abt (msg):
+	print (msg, file=sys.stderr);
+	exit (1);
+
+class Regs:
+	# the report of hostsim
+	STATUS = re.compile (r'^\S.* (OK|FAILED)$')
+	DELIV = re.compile (r'delivered ([0-9]+)/([0-9]+), missing ([0-9]+), '
+		r'queue drops ([0-9]+), duplicates ([0-9]+)')
+	CARS = re.compile (r'cars [0-9]+ \(([0-9.]+) per block\)')
+	LATENCY = re.compile (r'latency ([0-9.]+) ms mean, ([0-9.]+) ms 95%, '
+		r'([0-9.]+) ms max, peak queue ([0-9]+) blocks \(([0-9]+) bytes\)')
+	GOODPUT = re.compile (r'goodput ([0-9.]+) blocks/s')
+	ACKS = re.compile (r'ACKs.* ([0-9.]+) bytes mean')
+
+# the parameters in the order of TagParams (setp numbers)
+PARAMS = ('train_length', 'max_queued', 'car_space', 'min_train_space')
+OPTS = ('-t', '-q', '-c', '-s')
+
+# result columns
+COLS = PARAMS + ('ok', 'missing', 'qdrops', 'goodput', 'lat_mean', 'lat_95',
+	'lat_max', 'ram', 'cars', 'ackb')
+
+def call_options ():
+
+	ps = argparse.ArgumentParser (
+		prog='tune',
+		description='tunes the streaming parameters with hostsim',
+		epilog='')
+
+	ps.add_argument ("-r", "--rate", type=float, dest='rate', default=20.0,
+		help='blocks per second (default 20)')
+	ps.add_argument ("-l", "--loss", type=float, dest='loss', default=0.05,
+		help='Tag to Peg loss rate (default 0.05)')
+	ps.add_argument ("-a", "--ack-loss", type=float, dest='aloss',
+		default=None, help='ACK loss rate (default: as -l)')
+	ps.add_argument ("-g", "--gilbert", dest='ge',
+		help='bursty loss, gb:bg:p (see hostsim)')
+	ps.add_argument ("-t", "--train-length", dest='t',
+		default='16,32,64,128', help='train lengths')
+	ps.add_argument ("-q", "--max-queued", dest='q',
+		default='64,128,256', help='queue limits')
+	ps.add_argument ("-c", "--car-space", dest='c',
+		default='2,5,10', help='car spaces (msecs)')
+	ps.add_argument ("-s", "--train-space", dest='s',
+		default='8,16,32', help='minimum train spaces (msecs)')
+	ps.add_argument ("-k", "--codes", type=int, dest='codes', default=12,
+		help='codes per car (12-50, default 12)')
+	ps.add_argument ("-w", "--tdma", dest='tdma',
+		help='TDMA schedule, cycle:slots:slot (see hostsim)')
+	ps.add_argument ("-n", "--blocks", type=int, dest='blocks',
+		default=5000, help='blocks per run (default 5000)')
+	ps.add_argument ("-S", "--seeds", type=int, dest='seeds', default=3,
+		help='runs (seeds) per setting (default 3)')
+	ps.add_argument ("-m", "--max-ram", type=int, dest='ram', default=0,
+		help='RAM limit for the queue (bytes) for the recommendation')
+	ps.add_argument ("-j", "--jobs", type=int, dest='jobs', default=0,
+		help='number of parallel runs (default: all cores)')
+	ps.add_argument ("-o", "--output", dest='csv',
+		help='write all results to this file (tab-separated)')
+	ps.add_argument ("-x", "--hostsim", dest='hostsim',
+		default=os.path.join (os.path.dirname (
+			os.path.abspath (__file__)), 'hostsim'),
+		help='the harness (default: hostsim next to this script)')
+
+	return ps.parse_args ()
+
+def int_list (s, o):
+
+	try:
+		l = [int (v) for v in s.split (',')]
+	except Exception:
+		abt (f'illegal list for {o}, {s}')
+	if not l or min (l) < 0:
+		abt (f'illegal list for {o}, {s}')
+	return l
+
+###############################################################################
+
+def run_one (a):
+#
+# One run of hostsim: a = (command, setting), returns the parsed figures
+#
+	cmd, st = a
+	r = { 'ok': False }
+	try:
+		out = subprocess.run (cmd, capture_output=True, text=True,
+			timeout=600).stdout
+	except Exception as ex:
+		r ['error'] = str (ex)
+		return (st, r)
+
+	for ln in out.split ('\n'):
+		m = Regs.STATUS.match (ln)
+		if m:
+			r ['ok'] = m.group (1) == 'OK'
+			continue
+		m = Regs.DELIV.search (ln)
+		if m:
+			r ['missing'] = int (m.group (3))
+			r ['qdrops'] = int (m.group (4))
+			continue
+		m = Regs.CARS.search (ln)
+		if m:
+			r ['cars'] = float (m.group (1))
+			continue
+		m = Regs.ACKS.search (ln)
+		if m:
+			r ['ackb'] = float (m.group (1))
+			continue
+		m = Regs.LATENCY.search (ln)
+		if m:
+			r ['lat_mean'] = float (m.group (1))
+			r ['lat_95'] = float (m.group (2))
+			r ['lat_max'] = float (m.group (3))
+			r ['ram'] = int (m.group (5))
+			continue
+		m = Regs.GOODPUT.search (ln)
+		if m:
+			r ['goodput'] = float (m.group (1))
+
+	if 'goodput' not in r:
+		r ['ok'] = False
+	return (st, r)
+
+def combine (rl):
+#
+# The runs of one setting (different seeds): the worst case for loss,
+# latency and RAM, the mean for the rest
+#
+	if not all (r ['ok'] for r in rl):
+		return None
+	n = len (rl)
+	return {
+		'ok': True,
+		'missing': max (r ['missing'] for r in rl),
+		'qdrops': max (r ['qdrops'] for r in rl),
+		'goodput': sum (r ['goodput'] for r in rl) / n,
+		'lat_mean': sum (r ['lat_mean'] for r in rl) / n,
+		'lat_95': max (r ['lat_95'] for r in rl),
+		'lat_max': max (r ['lat_max'] for r in rl),
+		'ram': max (r ['ram'] for r in rl),
+		'cars': sum (r ['cars'] for r in rl) / n,
+		'ackb': sum (r ['ackb'] for r in rl) / n
+	}
+
+def objectives (r):
+
+	return (r ['missing'], -r ['goodput'], r ['lat_95'], r ['ram'])
+
+def pareto (res):
+#
+# The settings not dominated by any other; of those with identical
+# figures, only the smallest setting is kept
+#
+	def dominated (s, o):
+		ks, ko = objectives (res [s]), objectives (res [o])
+		if ks == ko:
+			return o < s
+		return all (x <= y for x, y in zip (ko, ks))
+
+	return [s for s in res if not any (dominated (s, o)
+		for o in res if o != s)]
+
+def recommend (res, front, ram):
+#
+# No loss (or the least), within the RAM limit, then the shortest tail
+# latency, the smallest RAM, and the fewest cars (airtime) per block
+#
+	cand = [s for s in front if not ram or res [s]['ram'] <= ram]
+	if not cand:
+		return None
+	ml = min (res [s]['missing'] for s in cand)
+	cand = [s for s in cand if res [s]['missing'] == ml]
+	return min (cand, key = lambda s: (res [s]['lat_95'], res [s]['ram'],
+		res [s]['cars']))
+
+def row (st, r):
+
+	return (f'{st [0]:5d} {st [1]:5d} {st [2]:4d} {st [3]:4d} '
+		f'{r ["missing"]:7d} {r ["goodput"]:8.2f} {r ["lat_mean"]:8.1f} '
+		f'{r ["lat_95"]:8.1f} {r ["lat_max"]:8.1f} {r ["ram"]:6d} '
+		f'{r ["cars"]:6.3f}')
+
+def fmt (v):
+
+	return f'{v:.3f}' if isinstance (v, float) else str (v)
+
+HEAD = ('Train Queue  Car  Spc Missing  Blk/s   Lat ms    Lat95   LatMax'
+	'    RAM   Cars')
+
+###############################################################################
+
+def main ():
+
+	import multiprocessing as mp
+
+	opts = call_options ()
+
+	if not os.access (opts.hostsim, os.X_OK):
+		abt (f'{opts.hostsim} not found, build it first: '
+			'g++ -O2 -I. -o hostsim hostsim.cc')
+
+	grid = [int_list (getattr (opts, p), o) for p, o in
+		zip (('t', 'q', 'c', 's'), OPTS)]
+	settings = [st for st in itertools.product (*grid)
+		if st [1] >= st [0] and st [0] > 0 and st [3] > 0]
+	if not settings:
+		abt ('no valid settings to try')
+
+	if opts.codes < 12 or opts.codes > 50:
+		abt (f'illegal -k, {opts.codes}, must be 12-50')
+
+	aloss = opts.loss if opts.aloss is None else opts.aloss
+	base = [opts.hostsim, '-n', str (opts.blocks), '-r', str (opts.rate),
+		'-l', str (opts.loss), '-a', str (aloss), '-k', str (opts.codes)]
+	if opts.ge:
+		base += ['-g', opts.ge]
+	if opts.tdma:
+		base += ['-w', opts.tdma]
+
+	runs = []
+	for st in settings:
+		cmd = base [:]
+		for o, v in zip (OPTS, st):
+			cmd += [o, str (v)]
+		for sd in range (1, opts.seeds + 1):
+			runs.append ((cmd + ['-S', str (sd)], st))
+
+	nj = opts.jobs if opts.jobs > 0 else (os.cpu_count () or 1)
+	print (f'{len (settings)} settings, {len (runs)} runs', file=sys.stderr)
+	if nj > 1:
+		with mp.Pool (min (nj, len (runs))) as pool:
+			out = pool.map (run_one, runs, chunksize = 1)
+	else:
+		out = [run_one (a) for a in runs]
+
+	per = { }
+	for st, r in out:
+		per.setdefault (st, []).append (r)
+
+	res = { }
+	nf = 0
+	for st in settings:
+		c = combine (per [st])
+		if c is None:
+			nf += 1
+		else:
+			res [st] = c
+
+	if opts.csv:
+		try:
+			fd = open (opts.csv, "w")
+		except Exception as ex:
+			abt (f'cannot open file {opts.csv} for writing, {ex}')
+		fd.write ('\t'.join (COLS) + '\n')
+		for st in settings:
+			r = res.get (st, { 'ok': False })
+			fd.write ('\t'.join ([str (v) for v in st] +
+				[fmt (r.get (c, '')) for c in COLS [len (PARAMS):]])
+				+ '\n')
+		fd.close ()
+
+	if not res:
+		abt ('all settings failed')
+
+	front = sorted (pareto (res), key = lambda s: (res [s]['missing'],
+		res [s]['lat_95'], res [s]['ram']))
+
+	print (f'Rate {opts.rate} blocks/s, loss {opts.loss}, ACK loss {aloss}'
+		+ (f', bursty {opts.ge}' if opts.ge else '') +
+		(f', TDMA {opts.tdma}' if opts.tdma else '') +
+		f', {opts.codes} codes per car'
+		f', {opts.seeds} seeds x {opts.blocks} blocks')
+	if nf:
+		print (f'{nf} settings failed (not drained or corrupt)')
+	print ('')
+	print ('Pareto front (missing, goodput, 95% latency, RAM):')
+	print (HEAD)
+	for st in front:
+		print (row (st, res [st]))
+
+	rc = recommend (res, front, opts.ram)
+	print ('')
+	if rc is None:
+		print ('No setting within the RAM limit')
+		exit (1)
+
+	print ('Recommended:')
+	print (HEAD)
+	print (row (rc, res [rc]))
+	print ('setp ' + ' '.join (f'{i}={v}' for i, v in enumerate (rc)))
+
+if __name__ == "__main__":
+	main ()
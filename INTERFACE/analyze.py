@@ -23,9 +23,52 @@ class Regs:
 	VECTOR = re.compile (_float + ' ' + _float + ' ' + _float)
 	NIL = re.compile (r'^--nil--')
 	MARK = re.compile (r'^@ ([0-9]+)')
+	AUDIO = re.compile (r'^~((?: +[0-9]+)+) *$')
 	DHDR = re.compile (r'^H: (.*)')
 	DTRR = re.compile (r'^T: (.*)')
 	RATE = re.compile (r'Rate: ' + _float)
+	BSIZE = re.compile (r'Block size: +([0-9]+) *$')
+
+class BinFmt:
+	# the binary (columnar) format written by the native assembler (-b),
+	# see assembler.cc for the layout
+	MAGIC = b'DGSB'
+	HSIZE = 64
+	HEADER = np.dtype ([
+		('magic', 'S4'),
+		('version', '<u2'),
+		('spb', '<u2'),
+		('cblocks', '<u4'),
+		('nchunks', '<u4'),
+		('nblocks', '<u8'),
+		('rate', '<f8'),
+		('start', '<u8'),
+		('marks', '<u8'),
+		('nmarks', '<u4'),
+		('params', 'u1', (4,)),
+		('unused', '<u8')
+	])
+	MARK = np.dtype ([('ts', '<u8'), ('mark', '<u4'), ('unused', '<u4')])
+
+	def chunk (cb, spb):
+		return np.dtype ([
+			('first', '<u8'),
+			('n', '<u4'),
+			('unused', '<u4'),
+			('ts', '<u8', (cb,)),
+			('lost', 'u1', (cb // 8,)),
+			('audio', 'u1', (cb // 8,)),
+			('x', '<i2', (cb * spb,)),
+			('y', '<i2', (cb * spb,)),
+			('z', '<i2', (cb * spb,))
+		])
+
+	def is_binary (ifn):
+		try:
+			with open (ifn, "rb") as fd:
+				return fd.read (4) == BinFmt.MAGIC
+		except Exception:
+			return False
 
 class DSet:
 
@@ -33,10 +76,12 @@ class DSet:
 # allowing us for various operations. We start small and clumsy with the
 # intention of updating this as we go.
 
-	# samples per block
+	# samples per block, unless the header says otherwise (the car size
+	# set with stream -size)
 	SPB = 12
+	MAXSPB = 50
 
-	def __init__ (self, ifn, toff = 0.0):
+	def __init__ (self, ifn, toff = 0.0, verbose = True):
 
 		# create the set from the input file representing a "cooked" sequence
 		# of samples produced by the collector
@@ -46,6 +91,7 @@ class DSet:
 		# assume this is specified in fractional seconds; we convert to
 		# milliseconds
 		self.time_offset = toff
+		self.verbose = verbose
 		self.duration = -1
 		self.line_count = 0
 		self.block_count = 0
@@ -53,6 +99,8 @@ class DSet:
 		self.values = []
 		self.rate = 0.0
 		self.marks = []
+		# microphone levels: (time stamp, [levels]) per block
+		self.audio = []
 		self.complete = False
 		self.missing = 0
 		self.__nils = 0
@@ -60,7 +108,13 @@ class DSet:
 		self.__stime = -1
 		self.__ctime = 0
 		self.__lmark = -1
-		self.__rsc = DSet.SPB
+		self.spb = DSet.SPB
+		self.__rsc = self.spb
+
+		if BinFmt.is_binary (ifn):
+			self.load_binary (ifn)
+			self.close ()
+			return
 
 		try:
 			self.__fd = open (ifn, "r")
@@ -79,12 +133,18 @@ class DSet:
 			if not m:
 				# first non-header line
 				if not hp:
-					fmterr ('header not found')
+					self.fmterr ('header not found')
 				break
 			# for now, we ignore the header except for checking for its formal
-			# presence; put in here code for processing the individual lines
-			# of the header
+			# presence and the block size; put in here code for processing
+			# the individual lines of the header
 			hp = True
+			m = Regs.BSIZE.match (m.group (1))
+			if m:
+				self.spb = int (m.group (1))
+				if self.spb < DSet.SPB or self.spb > DSet.MAXSPB:
+					self.fmterr ('illegal block size')
+				self.__rsc = self.spb
 
 		# now for the samples; first line already in
 		while 1:
@@ -121,6 +181,70 @@ class DSet:
 		# complete
 		self.close ()
 
+	def load_binary (self, ifn):
+
+		# the chunks are mapped, not read; the raw (int16) columns are
+		# available as self.columns ['x'], ['y'], ['z'] (one row per chunk)
+		try:
+			hdr = np.fromfile (ifn, dtype = BinFmt.HEADER, count = 1) [0]
+		except Exception as ex:
+			raise Exception (f'cannot read {ifn}, {ex}')
+		self.spb = int (hdr ['spb'])
+		if hdr ['version'] != 1 or self.spb < DSet.SPB or \
+		    self.spb > DSet.MAXSPB:
+			self.fmterr ('unsupported binary format')
+		cb = int (hdr ['cblocks'])
+		nc = int (hdr ['nchunks'])
+		nb = int (hdr ['nblocks'])
+		self.rate = float (hdr ['rate'])
+		self.block_count = nb
+		if nb == 0:
+			self.columns = None
+			return
+		self.columns = np.memmap (ifn, dtype = BinFmt.chunk (cb, self.spb),
+			mode = 'r', offset = BinFmt.HSIZE, shape = (nc,))
+		ch = self.columns
+
+		ts = ch ['ts'] . reshape (-1) [:nb]
+		lost = np.unpackbits (ch ['lost'], axis = 1,
+			bitorder = 'little') . reshape (-1) [:nb] . astype (bool)
+		audio = np.unpackbits (ch ['audio'], axis = 1,
+			bitorder = 'little') . reshape (-1) [:nb] . astype (bool)
+		self.__stime = int (ts [0])
+		self.__ctime = int (ts [-1])
+		self.missing = int (np.count_nonzero (lost)) * self.spb
+
+		x = ch ['x'] . reshape (-1, self.spb) [:nb]
+		y = ch ['y'] . reshape (-1, self.spb) [:nb]
+
+		# audio blocks: levels interleaved in x (even) and y (odd)
+		for i in np . flatnonzero (audio):
+			lv = np.empty (2 * self.spb, dtype = int)
+			lv [0::2] = x [i]
+			lv [1::2] = y [i]
+			self.audio.append ((int (ts [i]), lv.tolist ()))
+
+		# the accel samples are not materialised, see bchunks; lost blocks
+		# at the very end are dropped
+		keep = ~audio
+		self.__bkeep = keep
+		self.__blost = lost
+		vb = np.flatnonzero (~lost [keep])
+		self.values = None
+		self.number_of_samples = \
+			int (vb [-1] + 1) * self.spb if len (vb) else 0
+
+		if hdr ['nmarks']:
+			mk = np.fromfile (ifn, dtype = BinFmt.MARK,
+				count = int (hdr ['nmarks']),
+				offset = int (hdr ['marks']))
+			for t, m in zip (mk ['ts'], mk ['mark']):
+				m = int (m)
+				if m != self.__lmark:
+					self.__lmark = m
+					self.number_of_marks += 1
+					self.marks.append ((int (t), m))
+
 	def fmterr (self, msg = ""):
 		m = f'illegal contents of the input file {self.filename}'
 		if self.line_count > 0:
@@ -148,7 +272,7 @@ class DSet:
 		m = Regs.BHDR.match (line)
 		if m:
 			# block header
-			if self.__rsc != DSet.SPB:
+			if self.__rsc != self.spb:
 				# running sample count must be complete
 				self.fmterr ('illegal block size')
 			try:
@@ -169,7 +293,7 @@ class DSet:
 
 		m = Regs.VECTOR.match (line)
 		if m:
-			if self.__rsc == DSet.SPB:
+			if self.__rsc == self.spb:
 				# we are at the limit
 				self.fmterr ('block size exceeded')
 			# construct the vector
@@ -204,10 +328,25 @@ class DSet:
 			self.number_of_samples += 1
 			return
 
+		m = Regs.AUDIO.match (line)
+		if m:
+			# a block of microphone levels, takes the whole block; lost
+			# blocks are nil regardless of their type and count as
+			# accel samples
+			if self.__rsc != 0:
+				self.fmterr ('audio levels half way through the block')
+			try:
+				lv = [int (x) for x in m.group (1) . split ()]
+			except Exception:
+				self.fmterr ('illegal audio levels')
+			self.audio.append ((self.__ctime, lv))
+			self.__rsc = self.spb
+			return
+
 		m = Regs.NIL.match (line)
 		if m:
 			# a missing block
-			if self.__nils % DSet.SPB != self.__rsc:
+			if self.__nils % self.spb != self.__rsc:
 				# must start at a block boundary
 				self.fmterr ('nil value half way through the block')
 			# count them
@@ -236,12 +375,13 @@ class DSet:
 		if self.number_of_samples == 0:
 			self.fmterr ('no samples found')
 		# sanity check
-		if self.number_of_samples != len (self.values):
+		if self.values is not None and \
+		    self.number_of_samples != len (self.values):
 			self.fmterr ('internal error, bad size of values')
 		# compute this from ctime correcting for the last block; duration is
 		# expressed in seconds
 		self.duration = (self.__ctime - self.__stime) / 1000.0 + \
-			(DSet.SPB / self.rate)
+			(self.spb / self.rate)
 
 		nm = len (self.marks)
 		for i in range (0, nm):
@@ -251,15 +391,17 @@ class DSet:
 				t = 0.0
 			self.marks [i] = (t, m)
 
-		print (
+		if self.verbose:
+		    print (
 			f'Number of samples:  {self.number_of_samples:8d}\n'
 			f'Missing samples:    {self.missing:8d}\n'
 			f'Number of marks:    {nm:8d}\n'
+			f'Audio blocks:       {len (self.audio):8d}\n'
 			f'Samples per second: {self.rate:8.3f}\n'
 			f'Duration:           {self.duration:8.3f} seconds\n'
 			f'Time offset:        {self.time_offset:8.3f} seconds\n',
 			end = ""
-		)
+		    )
 
 		self.complete = True
 		# delete temporary variables
@@ -268,6 +410,60 @@ class DSet:
 		del self.__ctime
 		del self.__rsc
 
+	def chunks (self, size = 0):
+		# consecutive chunks of samples, see cxform; all but the last one
+		# are exactly size long
+		if size <= 0:
+			size = CHUNK
+		if self.values is None:
+			# binary, read from the mapped file piecewise
+			yield from rechunk (self.bchunks (), size)
+			return
+		for i in range (0, self.number_of_samples, size):
+			yield self.values [i:i+size]
+
+	def bchunks (self):
+		# the accel samples of a binary file, one piece per mapped chunk
+		# (or per CHUNK of a long gap); lost blocks are interpolated like
+		# nils in the text format, from the previous sample (zero at the
+		# beginning) to the next one, which may be chunks ahead
+		spb = self.spb
+		ch = self.columns
+		cb = len (ch [0] ['ts'])
+		prev = np.zeros (3)
+		# lost samples pending interpolation
+		pend = 0
+		for i in range (len (ch)):
+			b0 = i * cb
+			b1 = min (b0 + cb, self.block_count)
+			keep = self.__bkeep [b0:b1]
+			n = b1 - b0
+			v = np.stack ((ch [i] ['x'] . reshape (-1, spb) [:n] [keep],
+				ch [i] ['y'] . reshape (-1, spb) [:n] [keep],
+				ch [i] ['z'] . reshape (-1, spb) [:n] [keep]),
+				axis = -1) . reshape (-1, 3) / 32768.0
+			valid = np.repeat (~self.__blost [b0:b1] [keep], spb)
+			iv = np.flatnonzero (valid)
+			if len (iv) == 0:
+				pend += len (v)
+				continue
+			f = iv [0]
+			if pend + f:
+				# the gap leading to the first valid sample
+				g = pend + f
+				for k in range (0, pend, CHUNK):
+					yield lfill (prev, v [f], g, k,
+						min (k + CHUNK, pend))
+				v [:f] = lfill (prev, v [f], g, pend, g)
+			# the gaps between valid samples within the chunk
+			ix = np.flatnonzero (~valid [f:iv [-1] + 1]) + f
+			for j in range (3):
+				v [ix, j] = np.interp (ix, iv, v [iv, j])
+			pend = len (valid) - 1 - iv [-1]
+			v = v [:iv [-1] + 1]
+			prev = v [-1]
+			yield v
+
 	def graph (self, fxform, t0 = -1.0, t1 = -1.0):
 		# from t0 to t1, np - number of points (grain)
 		if t0 < 0.0:
@@ -287,78 +483,81 @@ class DSet:
 			em = "start time >= end time"
 		if em:
 			raise Exception ("graph: " + em)
-		# create point pairs
-		ss = int ((a / self.duration) * self.number_of_samples + 0.5)
-		se = int ((b / self.duration) * self.number_of_samples + 0.5) + 1
-		if se > self.number_of_samples:
-			se = self.number_of_samples
-
-		# extract and time the points, calculate total min and max, identify
-		# markers, create point sets
-		ymin = None
-		ymax = None
-		# a pset is a tuple: mark, X, Y
-		psets = []
-		Time = []
-		Vals = []
-		# current mark = none
-		cmark = -1
-		# index of the next mark in marks
-		imark = 0
-		# the number of entries in marks
-		nmarks = len (self.marks)
-		# determine the first limit
-		if nmarks:
-			# we do have marks at all
-			cmtime = self.marks [0][0]
-		else:
-			# no marks, use a sure sentinel
-			cmtime = self.duration + 1.0
-
-		# transform the points as required
-		points = fxform (self.values)
-
-		for i in range (0, self.number_of_samples):
-			# convert to values as requested
-			y = points [i]
-			# calculate total min and max
-			if ymin == None or y < ymin:
-				ymin = y
-			if ymax == None or y > ymax:
-				ymax = y
-			# relative time
-			t = (i * self.duration) / self.number_of_samples
-			if t >= cmtime:
-				if Vals:
-					# we do have a pending collection of points
-					psets.append ((cmark, Time.copy (), Vals.copy ()))
-					# reset
-					Time = []
-					Vals = []
-				# switch the mark
-				cmark = self.marks [imark][1]
-				# look for next mark
-				imark += 1
-				if imark < nmarks:
-					cmtime = self.marks [imark] [0]
-				else:
-					cmtime = self.duration + 1.0
-			if i >= ss and i < se:
-				# the point falls into our graph
-				Time.append (t + self.time_offset)
-				Vals.append (y)
-		# done with the loop, check if have a pending set
-		if Vals:
-			# can use the originals now, won't be overwritten anymore
-			psets.append ((cmark, Time, Vals))
+		n = self.number_of_samples
+		# sample range
+		ss = int ((a / self.duration) * n + 0.5)
+		se = int ((b / self.duration) * n + 0.5) + 1
+		if se > n:
+			se = n
+
 		fig, ax = plt.subplots (figsize=(10.0, 3.0), layout='constrained')
+
+		# pick the pyramid level yielding at least as many points as there
+		# are pixels across the graph
+		px = int (fig.get_figwidth () * fig.dpi)
+		pyr = self.pyramid (fxform)
+		lv = 0
+		while lv < pyr.levels () and \
+		    (se - ss) // (Pyramid.FACTOR ** (lv + 1)) >= px:
+			lv += 1
+
+		if lv == 0:
+			# the points proper
+			f = 1
+			bs = ss
+			Y = window (cxform (fxform, lambda: self.chunks ()), ss, se)
+			L = H = None
+		else:
+			f = Pyramid.FACTOR ** lv
+			bs = ss // f
+			be = (se + f - 1) // f
+			L, H, Y = pyr.level (lv)
+			L = L [bs:be]
+			H = H [bs:be]
+			Y = Y [bs:be]
+			bs *= f
+
+		# relative time of the points (bin starts)
+		X = (bs + np.arange (len (Y)) * f) * (self.duration / n)
+
+		# split into segments by marks
+		mt = [m [0] for m in self.marks]
+		mi = np.searchsorted (X, mt, side = 'left')
+		cuts = [0] + [int (c) for c in mi if 0 < c < len (Y)] + [len (Y)]
+		# mark in effect at the start of the window
+		k = np.searchsorted (mt, X [0], side = 'right') if len (Y) else 0
+		cmark = self.marks [k - 1] [1] if k > 0 else -1
+		for i in range (len (cuts) - 1):
+			c0, c1 = cuts [i], cuts [i + 1]
+			if i > 0:
+				# the marks switching at c0 (the last one wins)
+				k = np.searchsorted (mt, X [c0], side = 'right')
+				cmark = self.marks [k - 1] [1]
+			if c1 <= c0:
+				continue
+			color = mcolor (cmark)
+			T = X [c0:c1] + self.time_offset
+			ax.plot (T, Y [c0:c1], color = color)
+			if L is not None:
+				ax.fill_between (T, L [c0:c1], H [c0:c1], color = color,
+					alpha = 0.3, linewidth = 0)
+
+		# the total min and max
+		ymin, ymax = pyr.span ()
+		if ymin >= ymax:
+			ymax = ymin + 1.0
 		ax.axis ([a + self.time_offset, b + self.time_offset, ymin, ymax])
-		for i in range (0, len (psets)):
-			mark, X, Y = psets [i]
-			color = mcolor (mark)
-			ax.plot (X, Y, color = color)
 		plt.show ()
 
+	def pyramid (self, fxform):
+		# the (cached) decimation pyramid for the transform
+		if not hasattr (self, 'pyramids'):
+			self.pyramids = {}
+		k = xform_key (fxform)
+		if k not in self.pyramids:
+			self.pyramids [k] = Pyramid (self, fxform)
+		return self.pyramids [k]
+
 def mcolor (mark):
 #
 # returns the color corresponding to the mark
@@ -375,36 +574,41 @@ def mcolor (mark):
 		return 'green'
 	return 'orange'
 
-def write_output (ofn):
+def write_output (ofn, d = None):
 
 	global ds
 
+	if d is None:
+		d = ds
+
 	try:
 		fd = open (ofn, "w")
 	except Exception as ex:
 		abt (f'cannot open file {ofn} for writing, {ex}')
 
-	nl = len (ds.values)
-	for i in range (0, nl):
-		v = ds.values [i]
-		m = ""
-		for j in range (0, 3):
-			m += f' {v[j]:7.4f}'
-		fd.write (m + '\n');
+	for c in d.chunks ():
+		for v in c:
+			m = ""
+			for j in range (0, 3):
+				m += f' {v[j]:7.4f}'
+			fd.write (m + '\n');
 	fd.close ()
 
-def write_marks (mfn):
+def write_marks (mfn, d = None):
 
 	global ds
 
+	if d is None:
+		d = ds
+
 	try:
 		fd = open (mfn, "w")
 	except Exception as ex:
 		abt (f'cannot open file {mfn} for writing, {ex}')
 
-	nl = len (ds.marks)
+	nl = len (d.marks)
 	for i in range (0, nl):
-		v = ds.marks [i]
+		v = d.marks [i]
 		fd.write (f'{v [0]:8.3f} {v [1]:3d}\n')
 	fd.close ()
 
@@ -420,6 +624,19 @@ def call_options ():
 		help='time offset sssss.mmm')
 	ps.add_argument ("-c", "--command-mode", action='store_true',
 		dest='cmnd', help='command mode, overrides other arguments')
+	ps.add_argument ("-b", "--batch", dest='batch',
+		help='batch mode: a directory or a manifest (one file per line)')
+	ps.add_argument ("-j", "--jobs", type=int, dest='jobs', default=0,
+		help='number of worker processes for batch mode (default: all '
+			'cores)')
+	ps.add_argument ("-o", "--output-dir", dest='odir',
+		help='batch mode: write the output and marks files here')
+	ps.add_argument ("-s", "--summary", dest='summary',
+		help='batch mode: summary table file (default: stdout)')
+	ps.add_argument ("-a", "--alpha", type=float, dest='alpha',
+		help='EMA coefficient (gema)')
+	ps.add_argument ("-w", "--width", type=int, dest='width',
+		help='moving average width (gave)')
 
 	return ps.parse_args ()
 	
@@ -441,64 +658,289 @@ def mag (v):
 	return math.sqrt (v[0] * v[0] + v[1] * v[1] + v[2] * v[2])
 
 def avg (p):
-	a = 0.0
-	n = 0
-	for i in range (0, len (p)):
-		a += p [i]
-		n += 1
-	if not n:
+	if not len (p):
 		return 0.0
-	return a / n
-	
+	return float (np.mean (p))
+
+def vmag (vals):
+	# magnitudes of an array (or list) of vectors
+	v = np.asarray (vals, dtype = float) . reshape (-1, 3)
+	return np.sqrt (np.einsum ('ij,ij->i', v, v))
+
+def ema (p, alpha, a):
+	# exponential moving average starting from a; the recurrence is
+	# evaluated in closed form over blocks short enough for the powers of
+	# (1 - alpha) not to underflow
+	p = np.asarray (p, dtype = float)
+	if alpha >= 1.0 or not len (p):
+		return p.copy ()
+	if alpha <= 0.0:
+		return np.full (len (p), a)
+	b = 1.0 - alpha
+	bl = int (min (65536, max (1, 200.0 / -math.log10 (b))))
+	q = np.empty (len (p))
+	w = b ** -np.arange (bl)
+	for i in range (0, len (p), bl):
+		s = p [i:i+bl]
+		n = len (s)
+		# a_k = b^(k+1) a + alpha * b^k * sum (p_j / b^j, j <= k)
+		q [i:i+n] = (b * a + alpha * np.cumsum (s * w [:n])) / w [:n]
+		a = q [i+n-1]
+	return q
+
+def mavg (p, width, tail = None):
+	# moving average over the current and up to width previous samples;
+	# tail are the samples preceding p (for processing in chunks)
+	p = np.asarray (p, dtype = float)
+	t = 0
+	if tail is not None and len (tail):
+		t = len (tail)
+		p = np.concatenate ((tail, p))
+	c = np.concatenate (([0.0], np.cumsum (p)))
+	i = np.arange (t, len (p))
+	j = np.maximum (i - width, 0)
+	return (c [i + 1] - c [j]) / (i - j + 1)
+
 ###############################################################################
 
 def gmag (vals):
-	p = []
-	for i in range (0, len (vals)):
-		p.append (mag (vals [i]))
-	return p
+	return vmag (vals)
 
 def gdev (vals):
 	p = gmag (vals)
-	a = avg (p)
-	for i in range (0, len (p)):
-		p [i] = p [i] - a
-	return p
+	return p - avg (p)
 
 def gabs (vals):
-	p = gdev (vals)
-	for i in range (0, len (p)):
-		if p [i] < 0.0:
-			p [i] = -p[i]
-	return p
+	return np.abs (gdev (vals))
 		
 def gema (vals):
 	global alpha
 	p = gabs (vals)
-	a = avg (p)
-	for i in range (0, len (p)):
-		a = p [i] * alpha + a * (1 - alpha)
-		p [i] = a
-	return p
+	return ema (p, alpha, avg (p))
 
 def gave (vals):
 	global width
 	p = gabs (vals)
-	q = []
 	if width < 2:
 		return p
-	for i in range (0, len (p)):
-		j = i - width
-		if j < 0:
-			j = 0
-		n = 0
+	return mavg (p, width)
+
+###############################################################################
+
+# chunk size for processing recordings piecewise
+CHUNK = 1 << 16
+
+def cxform (fxform, chunks):
+	# chunked version of the transforms (one of gmag, gdev, gabs, gema,
+	# gave); chunks is a function returning a fresh iterator over
+	# consecutive chunks of samples (e.g., lambda: ds.chunks ()); the
+	# overall statistics (which the transforms need) are collected in
+	# preliminary passes, so the memory used is bounded by the chunk size;
+	# yields the transformed chunks
+	global alpha
+	global width
+	if fxform is gmag:
+		for v in chunks ():
+			yield vmag (v)
+		return
+	s = 0.0
+	n = 0
+	for v in chunks ():
+		p = vmag (v)
+		s += p.sum ()
+		n += len (p)
+	m = s / n if n else 0.0
+	if fxform is gdev:
+		for v in chunks ():
+			yield vmag (v) - m
+		return
+	if fxform is gema:
 		s = 0.0
-		while j <= i:
-			s = s + p [j]
-			n += 1
-			j += 1
-		q.append (s / n)
-	return q
+		for v in chunks ():
+			s += np.abs (vmag (v) - m) . sum ()
+		a = s / n if n else 0.0
+		for v in chunks ():
+			p = ema (np.abs (vmag (v) - m), alpha, a)
+			if len (p):
+				a = p [-1]
+			yield p
+		return
+	if fxform is gave and width >= 2:
+		tail = None
+		for v in chunks ():
+			p = np.abs (vmag (v) - m)
+			q = mavg (p, width, tail)
+			if tail is not None:
+				p = np.concatenate ((tail, p))
+			tail = p [-width:]
+			yield q
+		return
+	# gabs
+	for v in chunks ():
+		yield np.abs (vmag (v) - m)
+
+def rechunk (pieces, size):
+	# regroup a sequence of arrays into consecutive chunks of size (the
+	# last one may be shorter)
+	buf = []
+	n = 0
+	for p in pieces:
+		while len (p):
+			k = min (size - n, len (p))
+			buf.append (p [:k])
+			n += k
+			p = p [k:]
+			if n == size:
+				yield np.concatenate (buf)
+				buf = []
+				n = 0
+	if n:
+		yield np.concatenate (buf)
+
+def lfill (a, b, n, k0, k1):
+	# samples k0 ... k1 - 1 of n linearly interpolated between a and b
+	# (exclusive)
+	k = np.arange (k0 + 1, k1 + 1, dtype = float) . reshape (-1, 1)
+	return a + (b - a) * (k / (n + 1.0))
+
+def window (chunks, ss, se):
+	# extract samples ss ... se - 1 from a sequence of transformed chunks
+	r = []
+	i = 0
+	for p in chunks:
+		j = i + len (p)
+		if j > ss and i < se:
+			r.append (p [max (ss - i, 0):min (se - i, len (p))])
+		if j >= se:
+			break
+		i = j
+	if not r:
+		return np.empty (0)
+	return np.concatenate (r)
+
+def xform_key (fxform):
+	# identifies a transform along with its parameters
+	global alpha
+	global width
+	if fxform is gema:
+		return f'gema-{alpha:g}'
+	if fxform is gave:
+		return f'gave-{width:d}'
+	return fxform.__name__
+
+class Pyramid:
+
+# A min/max/mean decimation pyramid of a transformed recording: level k
+# (k >= 1) aggregates FACTOR^k consecutive points per bin. The pyramid is
+# built in one chunked pass and cached in a file next to the recording; the
+# cache is rebuilt if the recording changes.
+
+	FACTOR = 8
+
+	def __init__ (self, ds, fxform):
+
+		self.n = ds.number_of_samples
+		self.mn = []
+		self.mx = []
+		self.sm = []
+		self.cfile = f'{ds.filename}.{xform_key (fxform)}.pyr.npz'
+		try:
+			st = os.stat (ds.filename)
+			self.stamp = np.array ([st.st_mtime_ns, st.st_size, self.n],
+				dtype = np.int64)
+		except Exception:
+			self.stamp = np.array ([0, 0, self.n], dtype = np.int64)
+
+		if not self.load ():
+			self.build (ds, fxform)
+			self.save ()
+
+	def levels (self):
+		return len (self.mn)
+
+	def level (self, k):
+		# min, max, mean for level k >= 1
+		f = Pyramid.FACTOR ** k
+		sm = self.sm [k - 1]
+		cn = np.full (len (sm), float (f))
+		if len (cn):
+			cn [-1] = self.n - f * (len (cn) - 1)
+		return self.mn [k - 1], self.mx [k - 1], sm / cn
+
+	def span (self):
+		if not self.mn:
+			return 0.0, 0.0
+		return float (self.mn [-1] . min ()), float (self.mx [-1] . max ())
+
+	def build (self, ds, fxform):
+
+		F = Pyramid.FACTOR
+		mn = []
+		mx = []
+		sm = []
+		# CHUNK is a multiple of FACTOR, so only the last bin can be partial
+		for p in cxform (fxform, lambda: ds.chunks ()):
+			k = (len (p) // F) * F
+			if k:
+				r = p [:k] . reshape (-1, F)
+				mn.append (r.min (axis = 1))
+				mx.append (r.max (axis = 1))
+				sm.append (r.sum (axis = 1))
+			if k < len (p):
+				r = p [k:]
+				mn.append (np.array ([r.min ()]))
+				mx.append (np.array ([r.max ()]))
+				sm.append (np.array ([r.sum ()]))
+		if not mn:
+			return
+		mn = np.concatenate (mn)
+		mx = np.concatenate (mx)
+		sm = np.concatenate (sm)
+		while 1:
+			self.mn.append (mn)
+			self.mx.append (mx)
+			self.sm.append (sm)
+			if len (mn) < 2:
+				break
+			# next level
+			m = (-len (mn)) % F
+			mn = np.concatenate ((mn, np.full (m, np.inf))) . reshape (-1, F)
+			mx = np.concatenate ((mx, np.full (m, -np.inf))) . reshape (-1, F)
+			sm = np.concatenate ((sm, np.zeros (m))) . reshape (-1, F)
+			mn = mn.min (axis = 1)
+			mx = mx.max (axis = 1)
+			sm = sm.sum (axis = 1)
+
+	def load (self):
+		try:
+			with np.load (self.cfile) as d:
+				if not np.array_equal (d ['stamp'], self.stamp):
+					return False
+				nl = int (d ['levels'])
+				for k in range (1, nl + 1):
+					self.mn.append (d [f'mn{k}'])
+					self.mx.append (d [f'mx{k}'])
+					self.sm.append (d [f'sm{k}'])
+			return True
+		except Exception:
+			self.mn = []
+			self.mx = []
+			self.sm = []
+			return False
+
+	def save (self):
+		d = { 'stamp' : self.stamp, 'levels' : np.array (len (self.mn)) }
+		for k in range (len (self.mn)):
+			d [f'mn{k+1}'] = self.mn [k]
+			d [f'mx{k+1}'] = self.mx [k]
+			d [f'sm{k+1}'] = self.sm [k]
+		try:
+			with open (self.cfile, "wb") as fd:
+				np.savez (fd, **d)
+		except Exception as ex:
+			# not a problem, the pyramid will be rebuilt next time
+			print (f'cannot cache the pyramid in {self.cfile}, {ex}',
+				file=sys.stderr)
 
 ###############################################################################
 
@@ -508,6 +950,121 @@ def process_data (ds):
 
 ###############################################################################
 
+# the summary table columns
+BCOLS = ('file', 'samples', 'missing', 'marks', 'audio', 'rate', 'duration',
+	'mag', 'dev', 'ema_max', 'ave_max', 'error')
+
+def batch_files (src):
+	# the files to process: everything in a directory (except our own
+	# caches), or the files listed in a manifest (relative to its directory)
+	if os.path.isdir (src):
+		fl = []
+		for f in sorted (os.listdir (src)):
+			f = os.path.join (src, f)
+			if os.path.isfile (f) and not f.endswith ('.npz'):
+				fl.append (f)
+		return fl
+	try:
+		with open (src, "r") as fd:
+			lines = fd.readlines ()
+	except Exception as ex:
+		abt (f'cannot read manifest {src}, {ex}')
+	md = os.path.dirname (src)
+	fl = []
+	for l in lines:
+		l = l.strip ()
+		if l and not l.startswith ('#'):
+			fl.append (os.path.join (md, l))
+	return fl
+
+def batch_one (arg):
+	# process one file in a worker; returns a row of the summary table
+	global alpha
+	global width
+	fn, odir, alpha, width = arg
+	r = dict.fromkeys (BCOLS, '')
+	r ['file'] = fn
+	try:
+		d = DSet (fn, 0.0, False)
+		r ['samples'] = d.number_of_samples
+		r ['missing'] = d.missing
+		r ['marks'] = d.number_of_marks
+		r ['audio'] = len (d.audio)
+		r ['rate'] = f'{d.rate:.3f}'
+		r ['duration'] = f'{d.duration:.3f}'
+		# the transforms, in chunks
+		ch = lambda: d.chunks ()
+		s = 0.0
+		for p in cxform (gmag, ch):
+			s += p.sum ()
+		r ['mag'] = f'{s / max (d.number_of_samples, 1):.5f}'
+		s = 0.0
+		for p in cxform (gabs, ch):
+			s += p.sum ()
+		r ['dev'] = f'{s / max (d.number_of_samples, 1):.5f}'
+		m = 0.0
+		for p in cxform (gema, ch):
+			if len (p):
+				m = max (m, float (p.max ()))
+		r ['ema_max'] = f'{m:.5f}'
+		m = 0.0
+		for p in cxform (gave, ch):
+			if len (p):
+				m = max (m, float (p.max ()))
+		r ['ave_max'] = f'{m:.5f}'
+		if odir:
+			b = os.path.join (odir, os.path.basename (fn))
+			write_output (b + '.out', d)
+			write_marks (b + '.marks', d)
+	except Exception as ex:
+		r ['error'] = str (ex) . replace ('\t', ' ') . replace ('\n', ' ')
+	return r
+
+def do_batch (opts):
+
+	import multiprocessing as mp
+
+	global alpha
+	global width
+
+	fl = batch_files (opts.batch)
+	if not fl:
+		abt (f'no files to process in {opts.batch}')
+
+	if opts.odir:
+		try:
+			os.makedirs (opts.odir, exist_ok = True)
+		except Exception as ex:
+			abt (f'cannot create {opts.odir}, {ex}')
+
+	nj = opts.jobs if opts.jobs > 0 else (os.cpu_count () or 1)
+	args = [(f, opts.odir, alpha, width) for f in fl]
+	if nj > 1 and len (fl) > 1:
+		with mp.Pool (min (nj, len (fl))) as pool:
+			rows = pool.map (batch_one, args, chunksize = 1)
+	else:
+		rows = [batch_one (a) for a in args]
+
+	if opts.summary:
+		try:
+			fd = open (opts.summary, "w")
+		except Exception as ex:
+			abt (f'cannot open file {opts.summary} for writing, {ex}')
+	else:
+		fd = sys.stdout
+
+	fd.write ('\t'.join (BCOLS) + '\n')
+	for r in rows:
+		fd.write ('\t'.join (str (r [c]) for c in BCOLS) + '\n')
+
+	if fd is not sys.stdout:
+		fd.close ()
+
+	ne = sum (1 for r in rows if r ['error'])
+	print (f'{len (rows)} files processed, {ne} failed', file=sys.stderr)
+
+###############################################################################
+
 def do_command_mode ():
 
 	print ("command mode")
@@ -528,11 +1085,20 @@ def do_command_mode ():
 def main ():
 
 	global ds
+	global alpha
+	global width
 
 	init_globals ()
 	opts = call_options ()
+	if opts.alpha != None:
+		alpha = opts.alpha
+	if opts.width != None:
+		width = opts.width
 	cm = opts.cmnd
 	ds = None
+	if opts.batch:
+		do_batch (opts)
+		return
 	if cm or len (opts.files) == 0:
 		# this overrides everything else
 		do_command_mode ()
@@ -556,6 +1122,7 @@ def main ():
 	if mfn:
 		write_marks (mfn)
 
-main ()
+if __name__ == '__main__':
+	main ()
 
 
@@ -0,0 +1,1634 @@
+/*
+	Copyright 2002-2021 (C) Olsonet Communications Corporation
+	Programmed by Pawel Gburzynski
+	All rights reserved
+
+	This file is part of the PICOS platform
+
+*/
+
+//
+// Native version of assembler.tcl: same input (the raw stream file written
+// by ossi.tcl), same output (the "cooked" file read by analyze.py), same
+// statistics. The Tcl script remains as the reference implementation.
+//
+// Build:	g++ -O2 -o assembler assembler.cc
+// Usage:	assembler [-b binfile] [-m infile ...] [-w msec] [-d rate]
+//			[-s width] [-f file|:port [-a alpha] [-n width]]
+//			[infile [outfile]]
+//
+// With -b, the assembled stream is also written in a binary columnar format
+// (see below) that analyze.py can map directly into memory.
+//
+// With -m (which can be repeated), the extra input files are captures of
+// the same session collected (in parallel) by other pegs. The lines of all
+// inputs are merged by their absolute time (the header time + the line's
+// offset), duplicate blocks are dropped, and a block is only considered
+// lost if none of the pegs has received it. As the pegs see the EOTs at
+// slightly different times (and the captures may come from different
+// hosts), before an EOT is acted upon, the blocks received by the other
+// pegs up to msec (-w, default 1000) after it (and before their next line
+// of another kind) are taken in, so they can still fill the holes. The
+// copies of EOTs and marks relayed by the other pegs (within msec) are
+// ignored.
+// With the same capture given twice, the output is that of the capture
+// alone (mergecheck.py checks this). The trailer then includes a line for
+// every input showing its contribution; the copies of a block relayed by
+// the other pegs don't count as duplicates of the stream.
+//
+// With -d, the block time stamps come from a linear fit of the arrival
+// times of the on-time blocks (see drift_add below) rather than from the
+// arrival times themselves, and the trailer reports the fitted block period
+// and the drift of the tag's clock with respect to the nominal (accel)
+// sampling rate given as the argument (0 == unknown, the period only).
+//
+// With -s, the block time stamps are msecs of the clock of the Peg sending
+// the sync beacons (the sync command), so the files of all tags that heard
+// the same beacons are on one time base. The tag reports in its EOTs when
+// (on that clock) the samples taken so far had been read (see ossi.tcl); the
+// inputs are prescanned for those points (so they must be files), which are
+// smoothed (a local linear fit over width points on each side, 0 == none)
+// and interpolated at the end of every block. The trailer shows the number of
+// points, the mean distance of the points from the smoothed ones, and the
+// time of block 1; to plot several tags on one axis, give analyze.py (-t)
+// the differences of those times. The points are late by up to a sample
+// period (half of it on the average), the same for the tags sampling at the
+// same rate. The marks stay where they were. The clock
+// wraps every 2^32 ticks (18 hours): the files to align must not straddle
+// a wrap differently.
+//
+// With -f, the features of analyze.py (gmag, gdev, gabs, gema, gave) are
+// computed on the fly, in O(1) per sample, and published after every
+// (accel) block as the line:
+//
+//	bn ts mag dev ema ave
+//
+// where mag and dev are the block's averages, and ema and ave are the
+// values at the block's last sample. The target is a file (e.g., for tail
+// -f), or :port, for UDP datagrams (one line each) sent to 127.0.0.1:port.
+// alpha (-a, default 0.5) and width (-n, default 1) are as in analyze.py.
+// The mean magnitude subtracted to get the deviation is the running mean
+// (analyze.py uses the mean over the whole recording), and the EMA starts
+// from the first value (rather than the mean).
+//
+// Out-of-order blocks are kept in a ring buffer indexed by the block
+// number, so stashing and advancing cost O(1) per block regardless of how
+// badly the blocks are reordered. The 10-bit axis values are converted via
+// a precomputed table of strings.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+typedef	unsigned int		u32;
+typedef	unsigned long long	u64;
+
+// Codes (samples) per block: the default, and the maximum car size
+#define	STRM_NCODES	12
+#define	STRM_MAX_NCODES	50
+
+// Blocks further ahead of the smallest expected one are garbage (about 14
+// hours at 20 blocks/s, far beyond any outage the Tag's queue can bridge);
+// this bounds the stash
+#define	STASH_SPAN_MAX	(1 << 20)
+
+// ============================================================================
+
+// Statistics
+static	u64	STA_QDROP, STA_FOVFL, STA_MALLF, STA_PDROP, STA_NOBSO,
+		STA_NOORD, STA_NLOST, STA_NSTSH, STA_LTBLK, STA_NAUDB,
+		STA_NFARB;
+static	std::vector<u64> STA_LLOST;
+
+// The smallest expected block number
+static	u64	SMEXP = 1;
+
+// Block limit, continuation flag
+static	u64	LIMIT;
+static	bool	MORE;
+
+// Current input line number, current time stamp
+static	u64	ILNUM, CTS;
+
+// Codes (samples) per block, from the header
+static	u32	SPB = STRM_NCODES;
+
+// EOT delay for merged inputs
+static	u64	EOTDL = 1000;
+
+// For estimating block timing
+static	struct { u64 a, A, b, B; } TIMING;
+
+// Clock drift estimation (-d): the lower convex hull of the (block number,
+// arrival time) points of the on-time blocks, relative to the first one
+struct dpt_t {
+	long long	x, y;
+};
+
+static	bool	DRIFT;
+static	double	DR_NOMINAL;
+static	std::vector<dpt_t> DR_HULL;
+static	u64	DR_X0, DR_Y0, DR_N, DR_LTS;
+static	long double DR_SX, DR_SY;
+
+// Time sync (-s): the points (block + fraction, the coordinator's clock in
+// msecs), raw and smoothed
+struct spt_t {
+	double	x, y, s;
+};
+
+static	bool	SYNC;
+static	u32	SY_W;
+static	std::vector<spt_t> SY_PTS;
+
+// Marks pending output
+static	std::vector<std::pair<u64,std::string> > MARKS;
+static	size_t	MARKS_H;
+
+static	FILE	*OFD;
+
+// Flush after every input line (input from a pipe)
+static	bool	LIVE;
+
+// f16 strings for the 1024 possible (10-bit) axis values, and the values
+static	char	F16 [1024][8];
+static	double	F16V [1024];
+
+// Live features (-f)
+static	FILE	*LFD;
+static	int	LSOCK = -1;
+static	struct sockaddr_in LADDR;
+static	double	LF_ALPHA = 0.5, LF_SUM, LF_EMA, LF_WSUM;
+static	u32	LF_WIDTH = 1;
+static	u64	LF_N;
+static	std::vector<double> LF_WIN;
+
+// ============================================================================
+
+struct block_t {
+	u64	bn;			// 0 == empty slot
+	u64	ts;			// Arrival time (CTS)
+	u32	in;			// The input it came from
+	bool	audio;			// Microphone levels
+	u32	codes [STRM_MAX_NCODES];
+};
+
+// ============================================================================
+// Binary (columnar) output
+// ============================================================================
+//
+// Layout (little endian):
+//
+//	header (BIN_HSIZE bytes):
+//		char	magic [4]	"DGSB"
+//		u16	version
+//		u16	spb		samples per block (the car size)
+//		u32	cblocks		blocks per chunk (BIN_CBLOCKS)
+//		u32	nchunks
+//		u64	nblocks
+//		f64	rate		samples per second (as in the T: line)
+//		u64	start		start time (msecs since epoch)
+//		u64	marks		file offset of the marks
+//		u32	nmarks
+//		u8	options, range, bandwidth, rate (as in the H: lines)
+//		u64	unused
+//	nchunks x chunk (all of the same size):
+//		u64	first		number of the first block
+//		u32	n		blocks in the chunk (< cblocks in the last)
+//		u32	unused
+//		u64	ts [cblocks]	block time stamps
+//		u8	lost [cblocks/8]	bit map, bit i (LSB first) == block i
+//		u8	audio [cblocks/8]	bit map, mic levels
+//		i16	x [cblocks * spb]	raw axis values, v/32768 == the
+//		i16	y [cblocks * spb]	value in the text output
+//		i16	z [cblocks * spb]
+//	nmarks x mark:
+//		u64	ts		the time stamp of the preceding block
+//		u32	mark
+//		u32	unused
+//
+// An audio block holds its 2 * spb levels in x (even) and y (odd).
+//
+
+#define	BIN_MAGIC	"DGSB"
+#define	BIN_VERSION	1
+#define	BIN_HSIZE	64
+#define	BIN_CBLOCKS	256
+
+static	FILE	*BFD;
+
+static	struct {
+	u64	first;
+	u32	n;
+	u64	ts [BIN_CBLOCKS];
+	unsigned char	lost [BIN_CBLOCKS/8], audio [BIN_CBLOCKS/8];
+	// Only the first BIN_CBLOCKS * SPB entries are used
+	short	x [BIN_CBLOCKS * STRM_MAX_NCODES],
+		y [BIN_CBLOCKS * STRM_MAX_NCODES],
+		z [BIN_CBLOCKS * STRM_MAX_NCODES];
+} BCHUNK;
+
+static	u64	BIN_NCHUNKS, BIN_NBLOCKS, BIN_LTS;
+static	std::vector<std::pair<u64,u32> > BIN_MARKS;
+
+// ============================================================================
+
+struct input_t {
+	FILE		*fd;
+	const char	*name;
+	u64		tm;		// the header time
+	u64		ilnum;		// line number
+	bool		more;
+	std::string	line;		// the pending (next) line:
+	u64		ts;		//	absolute time stamp
+	char		tp;		//	type
+	size_t		rest;		//	offset of the contents
+	u64		nrcvd, nused,	// contribution statistics
+			ndupl, neots;
+};
+
+static	std::vector<input_t> INPUTS;
+static	input_t	*CIN;
+
+// EOTs and marks acted upon recently (with merged inputs), to spot their
+// copies relayed by the other pegs; ln starts with the line type
+struct rline_t {
+	u64		ts;
+	size_t		in;
+	std::string	ln;
+};
+
+static	std::deque<rline_t> RLINES;
+
+// The inputs of the blocks seen recently (with merged inputs), a ring
+// indexed by the block number; a copy of one of those blocks relayed by
+// another peg is not a duplicate of the stream
+struct rblk_t {
+	u64		bn;
+	u32		in;
+};
+
+#define	RBLKS_SIZE	(1 << 16)
+
+static	std::vector<rblk_t> RBLKS;
+
+// ============================================================================
+
+// The reorder stash: a ring of 2^n slots, slot = bn & (size - 1); the
+// contents span STASH_MIN ... STASH_MAX, which is always less than the size
+static	std::vector<block_t> STASH;
+static	u64	STASH_MIN, STASH_MAX, STASH_N;
+
+// ============================================================================
+
+static void err (const char *m) {
+
+	fprintf (stderr, "%s\n", m);
+	exit (1);
+}
+
+static void errl (const char *m, const char *ln) {
+
+	if (INPUTS . size () > 1)
+		fprintf (stderr, "%s: ", CIN -> name);
+	fprintf (stderr, "%s %llu, %s\n", m, ILNUM, ln);
+	exit (1);
+}
+
+static bool readline (input_t *in, std::string &line) {
+
+	static char *buf = NULL;
+	static size_t bsz = 0;
+	ssize_t n;
+
+	CIN = in;
+	while (1) {
+		if ((n = getline (&buf, &bsz, in -> fd)) < 0)
+			return false;
+		ILNUM = ++(in -> ilnum);
+		while (n && (buf [n-1] == '\n' || buf [n-1] == '\r'))
+			n--;
+		if (n) {
+			line . assign (buf, n);
+			return true;
+		}
+		// ignore empty lines (there won't be any)
+	}
+}
+
+static void init_f16 () {
+//
+// 16-bit to float for the values that can actually occur
+//
+	int i, w;
+
+	for (i = 0; i < 1024; i++) {
+		w = i << 6;
+		if (w & 0x8000)
+			w -= 65536;
+		snprintf (F16 [i], sizeof (F16 [i]), "%7.4f", w / 32768.0);
+		F16V [i] = w / 32768.0;
+	}
+}
+
+// ============================================================================
+
+static void bin_write (const void *b, size_t n) {
+
+	if (fwrite (b, 1, n, BFD) != n) {
+		fprintf (stderr, "cannot write the binary file, %s\n",
+			strerror (errno));
+		exit (1);
+	}
+}
+
+static void bin_header (u64 tm, const unsigned char *par, double rate,
+								u64 mo) {
+	unsigned char h [BIN_HSIZE];
+	unsigned short s;
+	u32 w;
+
+	memset (h, 0, sizeof (h));
+	memcpy (h, BIN_MAGIC, 4);
+	s = BIN_VERSION;
+	memcpy (h + 4, &s, 2);
+	s = (unsigned short) SPB;
+	memcpy (h + 6, &s, 2);
+	w = BIN_CBLOCKS;
+	memcpy (h + 8, &w, 4);
+	w = (u32) BIN_NCHUNKS;
+	memcpy (h + 12, &w, 4);
+	memcpy (h + 16, &BIN_NBLOCKS, 8);
+	memcpy (h + 24, &rate, 8);
+	memcpy (h + 32, &tm, 8);
+	memcpy (h + 40, &mo, 8);
+	w = (u32) BIN_MARKS . size ();
+	memcpy (h + 48, &w, 4);
+	memcpy (h + 52, par, 4);
+
+	fseek (BFD, 0, SEEK_SET);
+	bin_write (h, sizeof (h));
+}
+
+static void bin_flush () {
+//
+// Write out the current chunk
+//
+	u32 z = 0;
+
+	if (BCHUNK . n == 0)
+		return;
+
+	bin_write (&BCHUNK . first, 8);
+	bin_write (&BCHUNK . n, 4);
+	bin_write (&z, 4);
+	bin_write (BCHUNK . ts, sizeof (BCHUNK . ts));
+	bin_write (BCHUNK . lost, sizeof (BCHUNK . lost));
+	bin_write (BCHUNK . audio, sizeof (BCHUNK . audio));
+	bin_write (BCHUNK . x, BIN_CBLOCKS * SPB * sizeof (short));
+	bin_write (BCHUNK . y, BIN_CBLOCKS * SPB * sizeof (short));
+	bin_write (BCHUNK . z, BIN_CBLOCKS * SPB * sizeof (short));
+
+	BIN_NCHUNKS++;
+	memset (&BCHUNK, 0, sizeof (BCHUNK));
+}
+
+static void bin_block (u64 bn, u64 ts, const block_t *b) {
+//
+// Add a block to the binary output; b == NULL means a lost block
+//
+	u32 i, k, c;
+
+	if (BFD == NULL)
+		return;
+
+	if (BCHUNK . n == 0)
+		BCHUNK . first = bn;
+
+	i = BCHUNK . n++;
+	BCHUNK . ts [i] = BIN_LTS = ts;
+	k = i * SPB;
+
+	if (b == NULL) {
+		BCHUNK . lost [i >> 3] |= 1 << (i & 7);
+	} else if (b -> audio) {
+		BCHUNK . audio [i >> 3] |= 1 << (i & 7);
+		for (i = 0; i < SPB; i++, k++) {
+			c = b -> codes [i];
+			BCHUNK . x [k] = (short)((c >> 17) & 0x7fff);
+			BCHUNK . y [k] = (short)((c >> 2) & 0x7fff);
+		}
+	} else {
+		for (i = 0; i < SPB; i++, k++) {
+			c = b -> codes [i];
+			BCHUNK . x [k] = (short)((c >> 16) & 0xffc0);
+			BCHUNK . y [k] = (short)((c >>  6) & 0xffc0);
+			BCHUNK . z [k] = (short)((c <<  4) & 0xffc0);
+		}
+	}
+
+	BIN_NBLOCKS++;
+
+	if (BCHUNK . n == BIN_CBLOCKS)
+		bin_flush ();
+}
+
+static void bin_close (u64 tm, const unsigned char *par, double rate) {
+
+	u64 mo;
+	u32 z = 0;
+
+	bin_flush ();
+
+	mo = (u64) ftell (BFD);
+	for (size_t i = 0; i < BIN_MARKS . size (); i++) {
+		bin_write (&BIN_MARKS [i] . first, 8);
+		bin_write (&BIN_MARKS [i] . second, 4);
+		bin_write (&z, 4);
+	}
+
+	bin_header (tm, par, rate, mo);
+	fclose (BFD);
+}
+
+// ============================================================================
+
+static u64 ebt (u64 bn) {
+//
+// Estimate block time based on current running rate
+//
+	double t;
+
+	if (TIMING.b == 0)
+		// will not happen
+		return 0;
+
+	t = round ((double) TIMING.A +
+		(((double) TIMING.B - (double) TIMING.A) /
+		    ((double) TIMING.b - (double) TIMING.a)) *
+			((double) bn - (double) TIMING.a));
+
+	return t < 0.0 ? 0 : (u64) t;
+}
+
+// ============================================================================
+
+static void timing_add (u64 bn, u64 ts) {
+//
+// A block written in order (on time or from the stash) that arrived at ts
+//
+	if (TIMING.a == 0) {
+		TIMING.a = bn;
+		TIMING.A = ts;
+		return;
+	}
+	// calculate the running rate in milliseconds / block
+	TIMING.b = bn;
+	TIMING.B = ts;
+}
+
+// ============================================================================
+
+static void drift_add (u64 bn, u64 ts) {
+//
+// Add an on-time block. The arrival time is the block's time plus a delay
+// that is never negative, so the line under all points with the least
+// mean distance from them is the best estimate of the block timing that
+// is free of the transmission delays. That line runs along the edge of the
+// lower hull spanning the mean block number (a linear program whose optimum
+// is at a vertex). The hull of points coming in increasing x (as on-time
+// blocks do) is maintained in amortized O(1).
+//
+	dpt_t p;
+	size_t n;
+
+	if (DR_N == 0) {
+		DR_X0 = bn;
+		DR_Y0 = ts;
+	}
+
+	p . x = (long long)(bn - DR_X0);
+	p . y = (long long) ts - (long long) DR_Y0;
+
+	DR_N++;
+	DR_SX += p . x;
+	DR_SY += p . y;
+
+	while ((n = DR_HULL . size ()) > 1) {
+		const dpt_t &o = DR_HULL [n - 2], &a = DR_HULL [n - 1];
+		// drop a if it isn't below the segment o -> p
+		if ((__int128)(a . x - o . x) * (p . y - o . y) -
+		    (__int128)(a . y - o . y) * (p . x - o . x) > 0)
+			break;
+		DR_HULL . pop_back ();
+	}
+
+	DR_HULL . push_back (p);
+}
+
+static bool drift_line (double &a, double &b) {
+//
+// The current fit: t = a + b * (bn - DR_X0) + DR_Y0
+//
+	size_t lo, hi, m;
+	double xm;
+
+	if (DR_HULL . size () < 2)
+		return false;
+
+	xm = (double)(DR_SX / DR_N);
+
+	// the edge spanning xm
+	lo = 0;
+	hi = DR_HULL . size () - 1;
+	while (hi - lo > 1) {
+		m = (lo + hi) / 2;
+		if ((double) DR_HULL [m] . x <= xm)
+			lo = m;
+		else
+			hi = m;
+	}
+
+	b = (double)(DR_HULL [hi] . y - DR_HULL [lo] . y) /
+		(double)(DR_HULL [hi] . x - DR_HULL [lo] . x);
+	a = (double) DR_HULL [lo] . y - b * (double) DR_HULL [lo] . x;
+
+	return true;
+}
+
+static u64 dbt (u64 bn, u64 ts) {
+//
+// Drift-corrected block time; ts is the default (before there is a fit);
+// the time stamps never go back
+//
+	double a, b, t;
+
+	if (drift_line (a, b)) {
+		t = round (a + b * ((double) bn - (double) DR_X0) +
+			(double) DR_Y0);
+		ts = t < 0.0 ? 0 : (u64) t;
+	}
+
+	if (ts < DR_LTS)
+		ts = DR_LTS;
+
+	return DR_LTS = ts;
+}
+
+// ============================================================================
+
+static double live_sample (double m, double &dev) {
+//
+// One sample's magnitude in, dev and the windowed average out, the EMA
+// in LF_EMA
+//
+	double a;
+
+	LF_SUM += m;
+	LF_N++;
+	dev = m - LF_SUM / LF_N;
+	a = fabs (dev);
+
+	LF_EMA = LF_N == 1 ? a : (1.0 - LF_ALPHA) * LF_EMA + LF_ALPHA * a;
+
+	if (LF_WIDTH < 2)
+		return a;
+
+	// the current and up to width previous samples
+	u32 k = (u32)((LF_N - 1) % LF_WIN . size ());
+	if (LF_N > LF_WIN . size ())
+		LF_WSUM -= LF_WIN [k];
+	LF_WIN [k] = a;
+	LF_WSUM += a;
+
+	return LF_WSUM / (LF_N < LF_WIN . size () ? LF_N : LF_WIN . size ());
+}
+
+static void live_block (const block_t *b, u64 ts) {
+
+	double sm, sd, d, av;
+	char ln [128];
+	int i, n;
+	u32 c;
+
+	sm = sd = av = 0.0;
+	for (i = 0; i < (int) SPB; i++) {
+		double x, y, z, m;
+		c = b -> codes [i];
+		x = F16V [(c >> 22) & 0x3ff];
+		y = F16V [(c >> 12) & 0x3ff];
+		z = F16V [(c >>  2) & 0x3ff];
+		m = sqrt (x * x + y * y + z * z);
+		av = live_sample (m, d);
+		sm += m;
+		sd += d;
+	}
+
+	n = snprintf (ln, sizeof (ln), "%llu %llu %1.4f %1.4f %1.4f %1.4f\n",
+		b -> bn, ts, sm / SPB, sd / SPB, LF_EMA, av);
+
+	if (LFD != NULL) {
+		fwrite (ln, 1, n, LFD);
+		fflush (LFD);
+	} else {
+		// for live display only, failures don't matter
+		sendto (LSOCK, ln, n, 0, (struct sockaddr*) &LADDR,
+			sizeof (LADDR));
+	}
+}
+
+static void live_open (const char *t) {
+
+	char *e;
+	u32 p;
+
+	LF_WIN . assign (LF_WIDTH + 1, 0.0);
+
+	if (*t != ':') {
+		if ((LFD = fopen (t, "w")) == NULL) {
+			fprintf (stderr, "cannot open %s, %s\n", t,
+				strerror (errno));
+			exit (1);
+		}
+		fprintf (LFD, "# bn ts mag dev ema ave\n");
+		return;
+	}
+
+	p = (u32) strtoul (t + 1, &e, 10);
+	if (*e != '\0' || p == 0 || p > 65535)
+		err ("illegal -f port");
+
+	if ((LSOCK = socket (AF_INET, SOCK_DGRAM, 0)) < 0) {
+		fprintf (stderr, "cannot create socket, %s\n", strerror (errno));
+		exit (1);
+	}
+
+	memset (&LADDR, 0, sizeof (LADDR));
+	LADDR . sin_family = AF_INET;
+	LADDR . sin_port = htons ((unsigned short) p);
+	LADDR . sin_addr . s_addr = htonl (INADDR_LOOPBACK);
+}
+
+// ============================================================================
+
+// ============================================================================
+
+static void sync_scan (input_t *in) {
+//
+// Collect the sync points from the EOT lines of an input (then rewound)
+//
+	char *buf = NULL, *e;
+	size_t bsz = 0;
+	unsigned long long ls, bk, sb, sc;
+	unsigned int fg, sf;
+	double ba;
+	spt_t p;
+
+	while (getline (&buf, &bsz, in -> fd) >= 0) {
+		strtoull (buf, &e, 10);
+		if (e == buf || strncmp (e, " E: ", 4) != 0)
+			continue;
+		if (sscanf (e + 4, "%llu %llu %lf %x %llu %u %llu", &ls, &bk,
+		    &ba, &fg, &sb, &sf, &sc) != 7 || !(fg & 0x08))
+			continue;
+		p . x = (double) sb + sf / 65536.0;
+		// the raw clock for now
+		p . y = (double) sc;
+		SY_PTS . push_back (p);
+	}
+
+	free (buf);
+	rewind (in -> fd);
+}
+
+static bool spt_less (const spt_t &a, const spt_t &b) {
+
+	return a . x < b . x;
+}
+
+static void sync_prepare () {
+//
+// Order the points, unwrap the clock (RTC ticks) into msecs, drop the
+// duplicates (merged inputs) and the points going back, smooth
+//
+	std::vector<spt_t> pts;
+	double y, sx, sy, sxx, sxy, n, b;
+	size_t i, j, lo, hi;
+	u32 lc;
+
+	std::sort (SY_PTS . begin (), SY_PTS . end (), spt_less);
+
+	y = lc = 0;
+	for (i = 0; i < SY_PTS . size (); i++) {
+		spt_t p = SY_PTS [i];
+		u32 c = (u32) p . y;
+		// the consecutive points are close, the difference is signed
+		y = i ? y + (int)(c - lc) : (double) c;
+		lc = c;
+		p . y = y * 1000.0 / 65536.0;
+		if (!pts . empty () && (p . x <= pts . back () . x ||
+		    p . y <= pts . back () . y))
+			continue;
+		pts . push_back (p);
+	}
+
+	for (i = 0; i < pts . size (); i++) {
+		lo = i > SY_W ? i - SY_W : 0;
+		hi = i + SY_W < pts . size () ? i + SY_W : pts . size () - 1;
+		sx = sy = sxx = sxy = 0.0;
+		for (j = lo; j <= hi; j++) {
+			// relative to the point, for the precision
+			double dx = pts [j] . x - pts [i] . x,
+				dy = pts [j] . y - pts [i] . y;
+			sx += dx; sy += dy; sxx += dx * dx; sxy += dx * dy;
+		}
+		n = (double)(hi - lo + 1);
+		b = n * sxx - sx * sx;
+		b = b > 0.0 ? (n * sxy - sx * sy) / b : 0.0;
+		pts [i] . s = pts [i] . y + (sy - b * sx) / n;
+	}
+
+	SY_PTS . swap (pts);
+}
+
+static u64 sync_ts (u64 bn) {
+//
+// The time of the end of block bn: interpolated between the (smoothed)
+// points around it, extrapolated from the first or last two
+//
+	size_t lo, hi, m;
+	double t;
+
+	lo = 0;
+	hi = SY_PTS . size () - 1;
+	while (hi - lo > 1) {
+		m = (lo + hi) / 2;
+		if (SY_PTS [m] . x <= (double) bn)
+			lo = m;
+		else
+			hi = m;
+	}
+
+	t = SY_PTS [lo] . s + (SY_PTS [hi] . s - SY_PTS [lo] . s) *
+		((double) bn - SY_PTS [lo] . x) /
+			(SY_PTS [hi] . x - SY_PTS [lo] . x);
+
+	return t < 0.0 ? 0 : (u64) round (t);
+}
+
+// ============================================================================
+
+static u64 wblk_text (u64 bn, const char *bl, size_t len, u64 ts) {
+//
+// The marks go by ts (the arrival time), returns the time stamp written
+//
+
+	while (MARKS_H < MARKS . size ()) {
+		// the time of the mark
+		if (MARKS [MARKS_H] . first > ts)
+			break;
+		fprintf (OFD, "@ %s\n", MARKS [MARKS_H] . second . c_str ());
+		if (BFD != NULL)
+			BIN_MARKS . push_back (std::make_pair (BIN_LTS,
+			    (u32) strtoul (MARKS [MARKS_H] . second . c_str (),
+				NULL, 10)));
+		MARKS_H++;
+	}
+
+	if (MARKS_H == MARKS . size () && MARKS_H) {
+		MARKS . clear ();
+		MARKS_H = 0;
+	}
+
+	if (SYNC)
+		ts = sync_ts (bn);
+
+	fprintf (OFD, "%llu %llu\n", bn, ts);
+	fwrite (bl, 1, len, OFD);
+
+	return ts;
+}
+
+static void wblk (const block_t *b, bool timed) {
+//
+// Decode and write a block; timed == use CTS as the time stamp
+//
+	char bl [STRM_MAX_NCODES * 25 + 8], *p;
+	const char *s;
+	int i;
+	u32 c;
+	u64 ts;
+
+	p = bl;
+
+	if (b -> audio) {
+		// a single line of levels
+		STA_NAUDB++;
+		*p++ = '~';
+		for (i = 0; i < (int) SPB; i++) {
+			c = b -> codes [i];
+			p += sprintf (p, " %u %u", (c >> 17) & 0x7fff,
+				(c >> 2) & 0x7fff);
+		}
+		*p++ = '\n';
+	} else {
+		for (i = 0; i < (int) SPB; i++) {
+			c = b -> codes [i];
+			s = F16 [(c >> 22) & 0x3ff];
+			memcpy (p, s, 7); p += 7; *p++ = ' ';
+			s = F16 [(c >> 12) & 0x3ff];
+			memcpy (p, s, 7); p += 7; *p++ = ' ';
+			s = F16 [(c >>  2) & 0x3ff];
+			memcpy (p, s, 7); p += 7; *p++ = '\n';
+		}
+	}
+
+	if (!RBLKS . empty ()) {
+		RBLKS [b -> bn & (RBLKS_SIZE - 1)] . bn = b -> bn;
+		RBLKS [b -> bn & (RBLKS_SIZE - 1)] . in = b -> in;
+	}
+
+	ts = timed ? CTS : ebt (b -> bn);
+	if (DRIFT)
+		ts = dbt (b -> bn, ts);
+	ts = wblk_text (b -> bn, bl, p - bl, ts);
+	bin_block (b -> bn, ts, b);
+
+	if (!b -> audio && (LFD != NULL || LSOCK >= 0))
+		live_block (b, ts);
+}
+
+static void write_null (u64 bn) {
+
+	static const char *nl = "--nil-- --nil-- --nil--\n";
+	static std::string bl;
+
+	if (bl . empty ())
+		for (u32 i = 0; i < SPB; i++)
+			bl += nl;
+
+	u64 ts;
+
+	ts = ebt (bn);
+	if (DRIFT)
+		ts = dbt (bn, ts);
+
+	ts = wblk_text (bn, bl . data (), bl . size (), ts);
+	bin_block (bn, ts, NULL);
+}
+
+// ============================================================================
+
+static inline block_t *slot (u64 bn) {
+
+	return &(STASH [bn & (STASH . size () - 1)]);
+}
+
+static void stash_grow (u64 span) {
+//
+// Make sure the ring can hold blocks spanning span numbers
+//
+	std::vector<block_t> old;
+	size_t ns;
+
+	if (span < STASH . size ())
+		return;
+
+	for (ns = STASH . size () ? STASH . size () : 256; ns <= span; ns <<= 1);
+
+	old . swap (STASH);
+	STASH . assign (ns, block_t ());
+	for (size_t i = 0; i < ns; i++)
+		STASH [i] . bn = 0;
+
+	for (size_t i = 0; i < old . size (); i++)
+		if (old [i] . bn)
+			*slot (old [i] . bn) = old [i];
+}
+
+static void stash_next_min () {
+//
+// Remove the head, find the next one
+//
+	slot (STASH_MIN) -> bn = 0;
+	if (--STASH_N == 0)
+		return;
+	do {
+		STASH_MIN++;
+	} while (slot (STASH_MIN) -> bn != STASH_MIN);
+}
+
+static bool stash (const block_t &b) {
+//
+// Returns false if the block is a duplicate
+//
+	u64 bn = b . bn;
+
+	if (STASH_N == 0) {
+		stash_grow (1);
+		*slot (bn) = b;
+		STASH_MIN = STASH_MAX = bn;
+		STASH_N = 1;
+		STA_NOORD++;
+		return true;
+	}
+
+	if (bn > STASH_MAX) {
+		stash_grow (bn - STASH_MIN + 1);
+		*slot (bn) = b;
+		STASH_N++;
+		if (bn > STASH_MAX + 1)
+			STA_NOORD++;
+		STASH_MAX = bn;
+		return true;
+	}
+
+	if (bn >= STASH_MIN && slot (bn) -> bn == bn) {
+		// already there
+		if (slot (bn) -> in == b . in)
+			STA_NOBSO++;
+		return false;
+	}
+
+	if (bn < STASH_MIN) {
+		stash_grow (STASH_MAX - bn + 1);
+		STASH_MIN = bn;
+	}
+
+	*slot (bn) = b;
+	STASH_N++;
+	STA_NOORD++;
+	return true;
+}
+
+static void advance () {
+//
+// Try to advance the stash
+//
+	if (STASH_N == 0 || SMEXP < STASH_MIN)
+		// no way
+		return;
+
+	while (SMEXP > STASH_MIN) {
+		// cannot happen
+		STA_NOBSO++;
+		stash_next_min ();
+		if (STASH_N == 0)
+			return;
+	}
+
+	while (SMEXP == STASH_MIN) {
+		wblk (slot (SMEXP), false);
+		timing_add (SMEXP, slot (SMEXP) -> ts);
+		SMEXP++;
+		if (LIMIT && SMEXP > LIMIT) {
+			MORE = false;
+			return;
+		}
+		stash_next_min ();
+		if (STASH_N == 0)
+			return;
+	}
+}
+
+static void add_lost () {
+
+	write_null (SMEXP);
+
+	STA_NLOST++;
+
+	if (STA_LLOST . size () > 9)
+		STA_LLOST . erase (STA_LLOST . begin ());
+
+	STA_LLOST . push_back (SMEXP);
+}
+
+static void flush_stash () {
+
+	// stash size at completion
+	STA_NSTSH = STASH_N;
+	// last "good" block at termination
+	STA_LTBLK = SMEXP - 1;
+
+	while (MORE && STASH_N) {
+		block_t *b = slot (STASH_MIN);
+		while (MORE && SMEXP < b -> bn) {
+			add_lost ();
+			SMEXP++;
+			if (LIMIT && SMEXP > LIMIT) {
+				MORE = false;
+				return;
+			}
+		}
+		wblk (b, false);
+		timing_add (b -> bn, b -> ts);
+		SMEXP = b -> bn + 1;
+		stash_next_min ();
+		if (LIMIT && SMEXP > LIMIT) {
+			MORE = false;
+			return;
+		}
+	}
+}
+
+// ============================================================================
+
+static inline int hexval (char c) {
+
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static void block_line (const char *ln, bool au) {
+//
+// au == a block of microphone levels (two 15-bit levels per code)
+//
+	block_t b;
+	const char *p;
+	char *e;
+	int i, h;
+	u64 c;
+
+	// The block number: the first sequence of digits followed by a space
+	for (p = ln; *p != '\0'; p++) {
+		if (*p >= '0' && *p <= '9') {
+			b . bn = strtoull (p, &e, 10);
+			if (*e == ' ')
+				break;
+			p = e - 1;
+		}
+	}
+
+	if (*p == '\0')
+		errl ("illegal block line", ln);
+
+	p = e + 1;
+
+	CIN -> nrcvd++;
+
+	b . in = (u32)(CIN - &(INPUTS [0]));
+
+	if (b . bn < SMEXP) {
+		// the block number is less than smallest expected, just
+		// ignore
+		CIN -> ndupl++;
+		if (!RBLKS . empty ()) {
+			rblk_t *r = &(RBLKS [b . bn & (RBLKS_SIZE - 1)]);
+			if (r -> bn == b . bn && r -> in != b . in)
+				// seen from another peg
+				return;
+			// the first copy (of a lost block) seen
+			r -> bn = b . bn;
+			r -> in = b . in;
+		}
+		STA_NOBSO++;
+		return;
+	}
+
+	// decode
+	b . audio = au;
+	for (i = 0; i < (int) SPB; i++) {
+		while (*p == ' ' || *p == '\t')
+			p++;
+		if (*p == '\0')
+			errl ("illegal block line", ln);
+		c = 0;
+		while (*p != ' ' && *p != '\t' && *p != '\0') {
+			if ((h = hexval (*p)) < 0 || c > 0xffffffffULL)
+				errl ("illegal value in block in line", ln);
+			c = (c << 4) | h;
+			p++;
+		}
+		b . codes [i] = (u32) c;
+	}
+
+	while (*p == ' ' || *p == '\t')
+		p++;
+	if (*p != '\0')
+		errl ("illegal block line", ln);
+
+	if (b . bn == SMEXP) {
+		// on-time arrival
+		CIN -> nused++;
+		if (DRIFT)
+			drift_add (b . bn, CTS);
+		wblk (&b, true);
+		timing_add (b . bn, CTS);
+		SMEXP++;
+		if (LIMIT && b . bn >= LIMIT)
+			MORE = false;
+		else
+			advance ();
+		return;
+	}
+
+	if (b . bn - SMEXP >= STASH_SPAN_MAX) {
+		// garbage, the stash would have to span it
+		STA_NFARB++;
+		CIN -> ndupl++;
+		return;
+	}
+
+	// we still have a hole, stash the block
+	b . ts = CTS;
+	if (stash (b))
+		CIN -> nused++;
+	else
+		CIN -> ndupl++;
+}
+
+static void eot_line (const char *ln) {
+
+	unsigned long long ls, bk;
+	unsigned int fg;
+	double ba;
+	u64 ob;
+
+	if (sscanf (ln, "%llu %llu %lf %x", &ls, &bk, &ba, &fg) != 4)
+		errl ("illegal value in eot line", ln);
+
+	// flags
+	if (fg & 0x01)
+		STA_FOVFL++;
+	if (fg & 0x02)
+		STA_MALLF++;
+	if (fg & 0x04)
+		STA_QDROP++;
+	if (fg & 0xf0)
+		STA_PDROP += (fg >> 4) & 0x0f;
+
+	if (bk > ls + 1)
+		// garbage (the offset reaches below block 1), ignore as the
+		// Tcl version does
+		return;
+
+	// the oldest block that still can arrive after this point
+	ob = ls - bk + 1;
+
+	while (MORE && SMEXP < ob) {
+		// output a null block
+		add_lost ();
+		SMEXP++;
+		if (LIMIT && SMEXP > LIMIT)
+			MORE = false;
+		else if (STASH_N && STASH_MIN <= SMEXP)
+			advance ();
+	}
+}
+
+// ============================================================================
+
+static void out_put (const char *t, const char *h, const std::string &v) {
+
+	char hd [64];
+
+	snprintf (hd, sizeof (hd), "%s:", h);
+
+	fprintf (stderr, "%-20s %s\n", hd, v . c_str ());
+	fprintf (OFD, "%s: %-20s %s\n", t, hd, v . c_str ());
+}
+
+static std::string num (u64 n) {
+
+	char b [24];
+
+	snprintf (b, sizeof (b), "%llu", n);
+	return std::string (b);
+}
+
+static FILE *open_file (const char *fn, const char *mode) {
+
+	FILE *f;
+
+	if ((f = fopen (fn, mode)) == NULL) {
+		fprintf (stderr, "cannot open %s, %s\n", fn, strerror (errno));
+		exit (1);
+	}
+	return f;
+}
+
+static void next_line (input_t *in) {
+//
+// Read and preparse the next line of the input: "ms T: rest"
+//
+	const char *p;
+	char *e;
+	u64 ms;
+
+	if (!(in -> more = readline (in, in -> line)))
+		return;
+
+	p = in -> line . c_str ();
+	if (*p < '0' || *p > '9')
+		errl ("bad line", p);
+	ms = strtoull (p, &e, 10);
+	if (e [0] != ' ' || e [1] == '\0' || e [2] != ':' || e [3] != ' ')
+		errl ("bad line", p);
+	in -> ts = in -> tm + ms;
+	in -> tp = e [1];
+	in -> rest = (e + 4) - p;
+}
+
+static bool relayed (input_t *in, const char *ln) {
+//
+// With merged inputs: true if the current line (an EOT or a mark) is a
+// copy of one relayed by another peg up to EOTDL before
+//
+	std::string l (1, in -> tp);
+	size_t i;
+
+	while (!RLINES . empty () && RLINES . front () . ts + EOTDL < in -> ts)
+		RLINES . pop_front ();
+
+	l += ln;
+	for (i = 0; i < RLINES . size (); i++)
+		if (RLINES [i] . ln == l && &(INPUTS [RLINES [i] . in]) != in)
+			return true;
+
+	RLINES . push_back (rline_t ());
+	RLINES . back () . ts = in -> ts;
+	RLINES . back () . in = in - &(INPUTS [0]);
+	RLINES . back () . ln = l;
+
+	return false;
+}
+
+static void eot_merge (input_t *in, u64 tm) {
+//
+// With merged inputs, before acting upon an EOT: takes in the blocks
+// received by the other pegs up to EOTDL after it; tm is the time origin
+//
+	input_t *o;
+	size_t i;
+
+	for (i = 0; i < INPUTS . size (); i++) {
+		o = &(INPUTS [i]);
+		if (o == in)
+			continue;
+		while (MORE && o -> more && (o -> tp == 'B' || o -> tp == 'A') &&
+		    o -> ts <= in -> ts + EOTDL) {
+			CIN = o;
+			ILNUM = o -> ilnum;
+			CTS = o -> ts - tm;
+			block_line (o -> line . c_str () + o -> rest,
+				o -> tp == 'A');
+			next_line (o);
+		}
+	}
+
+	CIN = in;
+	ILNUM = in -> ilnum;
+	CTS = in -> ts - tm;
+}
+
+int main (int argc, char *argv []) {
+
+	std::string line;
+	unsigned long long tm;
+	unsigned int op, th, lr, rn, ba, ra, co, lm, sp;
+	char tb [64], *e;
+	unsigned char bpar [4];
+	time_t ts;
+	double f;
+	u64 s, h, m, n;
+	std::vector<const char*> extra;
+	const char *lfn = NULL;
+	input_t *in;
+	bool merge;
+
+	OFD = stdout;
+	tm = 0;
+	op = rn = ba = ra = 0;
+
+	argc--; argv++;
+
+	while (argc > 1 && argv [0][0] == '-' && argv [0][1] != '\0' &&
+	    argv [0][2] == '\0') {
+		if (argv [0][1] == 'b') {
+			BFD = open_file (argv [1], "w+b");
+		} else if (argv [0][1] == 'm') {
+			extra . push_back (argv [1]);
+		} else if (argv [0][1] == 'd') {
+			DR_NOMINAL = strtod (argv [1], &e);
+			if (*e != '\0' || DR_NOMINAL < 0.0)
+				err ("illegal -d value");
+			DRIFT = true;
+		} else if (argv [0][1] == 's') {
+			SY_W = (u32) strtoul (argv [1], &e, 10);
+			if (*e != '\0' || SY_W > 1000)
+				err ("illegal -s value");
+			SYNC = true;
+		} else if (argv [0][1] == 'f') {
+			lfn = argv [1];
+		} else if (argv [0][1] == 'a') {
+			LF_ALPHA = strtod (argv [1], &e);
+			if (*e != '\0' || LF_ALPHA < 0.0 || LF_ALPHA > 1.0)
+				err ("illegal -a value");
+		} else if (argv [0][1] == 'n') {
+			LF_WIDTH = (u32) strtoul (argv [1], &e, 10);
+			if (*e != '\0')
+				err ("illegal -n value");
+		} else if (argv [0][1] == 'w') {
+			EOTDL = strtoull (argv [1], &e, 10);
+			if (*e != '\0')
+				err ("illegal -w value");
+		} else {
+			break;
+		}
+		argc -= 2; argv += 2;
+	}
+
+	merge = !extra . empty ();
+	if (merge)
+		RBLKS . assign (RBLKS_SIZE, rblk_t ());
+
+	if (lfn != NULL)
+		live_open (lfn);
+
+	INPUTS . resize (extra . size () + 1);
+	for (size_t i = 0; i < INPUTS . size (); i++) {
+		in = &(INPUTS [i]);
+		in -> fd = NULL;
+		in -> ilnum = in -> nrcvd = in -> nused = in -> ndupl =
+			in -> neots = 0;
+		if (i)
+			in -> fd = open_file (in -> name = extra [i-1], "r");
+	}
+
+	in = &(INPUTS [0]);
+	if (argc > 0 && *argv [0] != '\0') {
+		in -> fd = open_file (in -> name = argv [0], "r");
+	} else {
+		in -> fd = stdin;
+		in -> name = "stdin";
+	}
+
+	if (argc > 1 && *argv [1] != '\0')
+		OFD = open_file (argv [1], "w");
+
+	for (size_t i = 0; i < INPUTS . size (); i++) {
+		// Input from a pipe (or terminal) means we are running
+		// behind the collector
+		struct stat st;
+		if (fstat (fileno (INPUTS [i] . fd), &st) != 0 ||
+		    !S_ISREG (st.st_mode))
+			LIVE = true;
+	}
+
+	if (!LIVE)
+		setvbuf (OFD, NULL, _IOFBF, 1 << 20);
+
+	if (SYNC) {
+		if (LIVE)
+			err ("-s needs input files");
+		for (size_t i = 0; i < INPUTS . size (); i++)
+			sync_scan (&(INPUTS [i]));
+		sync_prepare ();
+		if (SY_PTS . size () < 2) {
+			fprintf (stderr, "warning: fewer than two sync points, "
+				"-s ignored\n");
+			SYNC = false;
+		}
+	}
+
+	init_f16 ();
+
+	// read the header lines; the first input determines the parameters,
+	// the earliest start time is the origin for all of them; the car size
+	// (the last number) is absent in older files
+	for (size_t i = 0; i < INPUTS . size (); i++) {
+		unsigned long long t;
+		unsigned int o, r, b, a;
+		in = &(INPUTS [i]);
+		if (!readline (in, line))
+			errl ("the input file is empty", in -> name);
+		sp = STRM_NCODES;
+		if (sscanf (line . c_str (),
+		    "%llu %u %u %u %u %u %u %u %u %u", &t, &o, &th, &lr, &r,
+		    &b, &a, &co, &lm, &sp) < 9 || sp < STRM_NCODES ||
+		    sp > STRM_MAX_NCODES)
+			errl ("bad header in the input file", line . c_str ());
+		in -> tm = t;
+		if (i == 0) {
+			tm = t;
+			op = o; rn = r; ba = b; ra = a;
+			LIMIT = lm;
+			SPB = sp;
+			continue;
+		}
+		if (sp != SPB)
+			errl ("block size differs from the first input",
+				line . c_str ());
+		if (o != op || r != rn || b != ba || a != ra)
+			fprintf (stderr, "warning: %s: parameters differ from "
+				"those in %s\n", in -> name,
+					INPUTS [0] . name);
+		if (t < tm)
+			tm = t;
+	}
+
+	// output the header
+	ts = (time_t)(tm / 1000);
+	strftime (tb, sizeof (tb), "%c", localtime (&ts));
+	snprintf (tb + strlen (tb), sizeof (tb) - strlen (tb), " <%03llu>",
+		tm % 1000);
+
+	out_put ("H", "Start time", tb);
+	snprintf (tb, sizeof (tb), "%02x", op);
+	out_put ("H", "Options", tb);
+	out_put ("H", "Range", num (rn));
+	out_put ("H", "Bandwidth", num (ba));
+	out_put ("H", "Rate", num (ra));
+	out_put ("H", "Block size", num (SPB));
+
+	if (BFD != NULL) {
+		bpar [0] = (unsigned char) op;
+		bpar [1] = (unsigned char) rn;
+		bpar [2] = (unsigned char) ba;
+		bpar [3] = (unsigned char) ra;
+		// A placeholder, the header is completed at the end
+		bin_header (tm, bpar, 0.0, 0);
+	}
+
+	MORE = true;
+
+	for (size_t i = 0; i < INPUTS . size (); i++)
+		next_line (&(INPUTS [i]));
+
+	while (MORE) {
+		const char *p;
+		// the input with the earliest pending line
+		in = NULL;
+		for (size_t i = 0; i < INPUTS . size (); i++)
+			if (INPUTS [i] . more && (in == NULL ||
+			    INPUTS [i] . ts < in -> ts))
+				in = &(INPUTS [i]);
+		if (in == NULL)
+			break;
+		CIN = in;
+		ILNUM = in -> ilnum;
+		CTS = in -> ts - tm;
+		p = in -> line . c_str () + in -> rest;
+		if (in -> tp == 'B') {
+			block_line (p, false);
+		} else if (in -> tp == 'A') {
+			block_line (p, true);
+		} else if (in -> tp == 'E') {
+			in -> neots++;
+			if (merge) {
+				if (relayed (in, p))
+					// the same EOT relayed by another peg
+					// only counts once
+					goto Next;
+				eot_merge (in, tm);
+			}
+			eot_line (p);
+		} else if (in -> tp == 'M') {
+			const char *q = p;
+			if (merge && relayed (in, p))
+				goto Next;
+			while (*q >= '0' && *q <= '9')
+				q++;
+			if (q == p) {
+				fprintf (stderr, "bad mark id, line number "
+					"%llu\n", ILNUM);
+				exit (1);
+			}
+			MARKS . push_back (std::make_pair (CTS,
+				std::string (p, q - p)));
+		} else {
+			fprintf (stderr, "bad line type %c, line number %llu\n",
+				in -> tp, ILNUM);
+			exit (1);
+		}
+Next:
+		if (LIVE)
+			fflush (OFD);
+		next_line (in);
+	}
+
+	// the tail
+	flush_stash ();
+
+	// estimate the rate
+	if (TIMING . b == 0) {
+		f = 0.0;
+	} else {
+		f = ((double)(TIMING . b - TIMING . a) /
+			((double) TIMING . B - (double) TIMING . A)) * SPB * 1000.0;
+		// the accel rate: discount the blocks of microphone levels
+		n = SMEXP - 1 - STA_NLOST;
+		if (STA_NAUDB && n > 0)
+			f = f * (double)(n - STA_NAUDB) / (double) n;
+	}
+	snprintf (tb, sizeof (tb), "%1.3f", f);
+
+	if (BFD != NULL)
+		// The rate as it appears in the text output
+		bin_close (tm, bpar, strtod (tb, NULL));
+
+	s = TIMING . B / 1000;
+	h = s / 3600;
+	s -= h * 3600;
+	m = s / 60;
+	s -= m * 60;
+
+	// statistics
+	out_put ("T", "Total blocks", num (SMEXP - 1));
+	out_put ("T", "Rate", tb);
+	out_put ("T", "Accounted for", num (STA_LTBLK));
+	out_put ("T", "Audio blocks", num (STA_NAUDB));
+	out_put ("T", "Out of order", num (STA_NOORD));
+	line = num (STA_NLOST) + " " + num (STA_PDROP);
+	if (STA_NLOST) {
+		line += " [";
+		for (size_t i = 0; i < STA_LLOST . size (); i++) {
+			if (i)
+				line += " ";
+			line += num (STA_LLOST [i]);
+		}
+		line += "]";
+	}
+	out_put ("T", "Lost (OSS/Peg)", line);
+	out_put ("T", "Duplicate", num (STA_NOBSO));
+	if (STA_NFARB)
+		out_put ("T", "Far ahead", num (STA_NFARB));
+	out_put ("T", "Queue drops", num (STA_QDROP));
+	out_put ("T", "FIFO overflows", num (STA_FOVFL));
+	out_put ("T", "Malloc faults", num (STA_MALLF));
+	out_put ("T", "Time", num (h) + " hours, " + num (m) + " minutes, " +
+		num (s) + " seconds");
+
+	if (DRIFT) {
+		double a, b;
+		if (drift_line (a, b)) {
+			snprintf (tb, sizeof (tb), "%1.4f ms", b);
+			out_put ("T", "Block period", tb);
+			n = SMEXP - 1 - STA_NLOST;
+			if (DR_NOMINAL > 0.0 && n > STA_NAUDB) {
+				// nominal period per block number (the
+				// microphone blocks take their share)
+				f = (SPB * 1000.0 / DR_NOMINAL) *
+					(double)(n - STA_NAUDB) / (double) n;
+				snprintf (tb, sizeof (tb), "%+1.1f ppm",
+					(b / f - 1.0) * 1000000.0);
+				out_put ("T", "Clock drift", tb);
+			}
+			// mean distance of the on-time arrivals from the fit
+			snprintf (tb, sizeof (tb), "%1.1f ms",
+				(double)(DR_SY / DR_N) - a -
+					b * (double)(DR_SX / DR_N));
+			out_put ("T", "Mean latency", tb);
+		} else {
+			out_put ("T", "Block period", "unknown");
+		}
+	}
+
+	if (SYNC) {
+		for (f = 0.0, n = 0; n < SY_PTS . size (); n++)
+			f += fabs (SY_PTS [n] . y - SY_PTS [n] . s);
+		out_put ("T", "Sync points", num (SY_PTS . size ()));
+		snprintf (tb, sizeof (tb), "%1.2f ms", f / SY_PTS . size ());
+		out_put ("T", "Sync jitter", tb);
+		out_put ("T", "Sync origin", num (sync_ts (1)) + " ms");
+	}
+
+	if (merge) {
+		for (size_t i = 0; i < INPUTS . size (); i++) {
+			in = &(INPUTS [i]);
+			snprintf (tb, sizeof (tb), "Peg %u", (u32) i + 1);
+			out_put ("T", tb, std::string (in -> name) + ": " +
+				num (in -> nrcvd) + " received, " +
+				num (in -> nused) + " used, " +
+				num (in -> ndupl) + " duplicate, " +
+				num (in -> neots) + " EOTs");
+		}
+	}
+
+	if (LFD != NULL)
+		fclose (LFD);
+	if (LSOCK >= 0)
+		close (LSOCK);
+
+	fclose (OFD);
+
+	return 0;
+}
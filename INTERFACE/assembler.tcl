@@ -20,6 +20,7 @@ set STA(NLOST)		0
 set STA(LLOST)		""
 set STA(NSTSH)		0
 set STA(LTBLK)		0
+set STA(NAUDB)		0
 
 # the smallest expected block numer
 set SMEXP		1
@@ -31,6 +32,9 @@ set STASH_MAX		0
 # current input line number
 set ILNUM		0
 
+# codes (samples) per block, from the header
+set SPB			12
+
 proc err { m } {
 
 	puts stderr $m
@@ -66,7 +70,12 @@ proc to_f16 { w } {
 
 proc wblk { bn bl { ts -1 } } {
 
-	global OFD MARKS
+	global OFD MARKS STA
+
+	if { [string index $bl 0] == "~" } {
+		# microphone levels
+		incr STA(NAUDB)
+	}
 
 	if { $ts < 0 } {
 		# estimate block time
@@ -108,9 +117,27 @@ proc ebt { bn } {
 	}
 }
 
-proc block_line { ln } {
+proc timing_add { bn ts } {
+#
+# A block written in order (on time or from the stash) that arrived at ts
+#
+	global TIMING
+
+	if { $TIMING(a) == 0 } {
+		set TIMING(a) $bn
+		set TIMING(A) $ts
+		return
+	}
+	# calculate the running rate in milliseconds / block
+	set TIMING(b) $bn
+	set TIMING(B) $ts
+}
 
-	global ILNUM SMEXP STA CTS LIMIT MORE TIMING
+proc block_line { ln { au 0 } } {
+#
+# au != 0 means a block of microphone levels (two 15-bit levels per code)
+#
+	global ILNUM SMEXP STA CTS LIMIT MORE SPB
 
 	if ![regexp {([[:digit:]]+) (.*)} $ln ma bn vals] {
 		err "illegal block line $ILNUM, $ln"
@@ -124,11 +151,16 @@ proc block_line { ln } {
 	}
 
 	# decode
-	if { [llength $vals] != 12 } {
+	if { [llength $vals] != $SPB } {
 		err "illegal block line $ILNUM, $ln"
 	}
 
-	set bl ""
+	if $au {
+		# a single line of levels
+		set bl "~"
+	} else {
+		set bl ""
+	}
 
 	foreach c $vals {
 
@@ -136,6 +168,12 @@ proc block_line { ln } {
 			err "illegal value in block in line ILNUM, $ln"
 		}
 
+		if $au {
+			append bl " [expr { ($c >> 17) & 0x7fff }]\
+				[expr { ($c >> 2) & 0x7fff }]"
+			continue
+		}
+
 		set x [to_f16 [expr { ($c >> 16) & 0xffc0 }]]
 		set y [to_f16 [expr { ($c >>  6) & 0xffc0 }]]
 		set z [to_f16 [expr { ($c <<  4) & 0xffc0 }]]
@@ -143,35 +181,34 @@ proc block_line { ln } {
 		append bl "$x $y $z\n"
 	}
 
+	if $au {
+		append bl "\n"
+	}
+
 	if { $bn == $SMEXP } {
 		# on-time arrival
 		wblk $bn $bl $CTS
+		timing_add $bn $CTS
 		incr SMEXP
 		if { $LIMIT && $bn >= $LIMIT } {
 			set MORE 0
 		} else {
 			advance
 		}
-		if { $TIMING(a) == 0 } {
-			set TIMING(a) $bn
-			set TIMING(A) $CTS
-			return
-		}
-		# calculate the running rate in milliseconds / block
-		set TIMING(b) $bn
-		set TIMING(B) $CTS
 		return
 	}
 
 	# we still have a hole, stash the block
-	stash $bn $bl
+	stash $bn $bl $CTS
 }
 
 proc write_null { bn } {
 
+	global SPB
+
 	set bl ""
 
-	for { set i 0 } { $i < 12 } { incr i } {
+	for { set i 0 } { $i < $SPB } { incr i } {
 		append bl "--nil-- --nil-- --nil--\n"
 	}
 
@@ -231,11 +268,13 @@ proc eot_line { ln } {
 	}
 }
 
-proc stash { bn bl } {
-
+proc stash { bn bl ts } {
+#
+# ts is the arrival time
+#
 	global STASH STASH_MIN STASH_MAX STA
 
-	set it [list $bn $bl]
+	set it [list $bn $bl $ts]
 
 	if { $STASH == "" } {
 		set STASH [list $it]
@@ -300,6 +339,7 @@ proc advance { } {
 
 	while { $SMEXP == $STASH_MIN } {
 		wblk $SMEXP [lindex $STASH 0 1]
+		timing_add $SMEXP [lindex $STASH 0 2]
 		incr SMEXP
 		if { $LIMIT && $SMEXP > $LIMIT } {
 			set MORE 0
@@ -323,7 +363,7 @@ proc flush_stash { } {
 	set STA(LTBLK) [expr { $SMEXP - 1 }]
 
 	while { $MORE && $STASH != "" } {
-		lassign [lindex $STASH 0] bn bl
+		lassign [lindex $STASH 0] bn bl ts
 		while { $MORE && $SMEXP < $bn } {
 			add_lost
 			incr SMEXP
@@ -333,6 +373,7 @@ proc flush_stash { } {
 			}
 		}
 		wblk $bn $bl
+		timing_add $bn $ts
 		set STASH [lrange $STASH 1 end]
 		set SMEXP [expr { $bn + 1 }]
 		if { $LIMIT && $SMEXP > $LIMIT } {
@@ -358,7 +399,7 @@ proc out_put { t h v } {
 
 proc main { } {
 
-	global argv IFD OFD ILNUM CTS STA SMEXP LIMIT MORE TIMING MARKS
+	global argv IFD OFD ILNUM CTS STA SMEXP LIMIT MORE TIMING MARKS SPB
 
 	set fn [lindex $argv 0]
 
@@ -387,8 +428,15 @@ proc main { } {
 		err "the input file is empty"
 	}
 
-	if { [scan $ln "%lu %u %u %u %u %u %u %u %u" \
-	    tm op th lr rn ba ra co lm] != 9 } {
+	# the car size (codes per block) is absent in older files
+	set n [scan $ln "%lu %u %u %u %u %u %u %u %u %u" \
+	    tm op th lr rn ba ra co lm sp]
+	if { $n == 10 } {
+		if { $sp < 12 || $sp > 50 } {
+			err "bad block size in the header of the input file"
+		}
+		set SPB $sp
+	} elseif { $n != 9 } {
 		err "bad header in the input file"
 	}
 
@@ -402,6 +450,7 @@ proc main { } {
 	out_put "H" "Range" $rn
 	out_put "H" "Bandwidth" $ba
 	out_put "H" "Rate" $ra
+	out_put "H" "Block size" $SPB
 
 	set LIMIT $lm
 	set MORE 1
@@ -424,6 +473,8 @@ proc main { } {
 		}
 		if { $tp == "B" } {
 			block_line $ln
+		} elseif { $tp == "A" } {
+			block_line $ln 1
 		} elseif { $tp == "E" } {
 			eot_line $ln
 		} elseif { $tp == "M" } {
@@ -445,7 +496,12 @@ proc main { } {
 		set f 0.0
 	} else {
 		set f [expr { (double($TIMING(b) - $TIMING(a)) /
-			($TIMING(B) - $TIMING(A))) * 12000.0 }]
+			($TIMING(B) - $TIMING(A))) * $SPB * 1000.0 }]
+		# the accel rate: discount the blocks of microphone levels
+		set n [expr { $SMEXP - 1 - $STA(NLOST) }]
+		if { $STA(NAUDB) && $n > 0 } {
+			set f [expr { $f * ($n - $STA(NAUDB)) / double($n) }]
+		}
 		set f [format %1.3f $f]
 	}
 
@@ -459,6 +515,7 @@ proc main { } {
 	out_put "T" "Total blocks" [expr { $SMEXP - 1}]
 	out_put "T" "Rate" $f
 	out_put "T" "Accounted for" $STA(LTBLK)
+	out_put "T" "Audio blocks" $STA(NAUDB)
 	out_put "T" "Out of order"  $STA(NOORD)
 	set w "$STA(NLOST) $STA(PDROP)"
 	if $STA(NLOST) {
@@ -31,6 +31,9 @@ set STASH_MAX		0
 # current input line number
 set ILNUM		0
 
+# codes (samples) per block, from the header
+set SPB			12
+
 proc err { m } {
 
 	puts stderr $m
@@ -129,7 +132,7 @@ proc wqstat { bb } {
 
 proc block_line { ln } {
 
-	global ILNUM SMEXP STA CTS LIMIT MORE TIMING
+	global ILNUM SMEXP STA CTS LIMIT MORE TIMING SPB
 
 	if ![regexp {([[:digit:]]+) (.*)} $ln ma bn vals] {
 		err "illegal block line $ILNUM, $ln"
@@ -143,7 +146,7 @@ proc block_line { ln } {
 	}
 
 	# decode
-	if { [llength $vals] != 12 } {
+	if { [llength $vals] != $SPB } {
 		err "illegal block line $ILNUM, $ln"
 	}
 
@@ -190,9 +193,11 @@ proc block_line { ln } {
 
 proc write_null { bn } {
 
+	global SPB
+
 	set bl ""
 
-	for { set i 0 } { $i < 12 } { incr i } {
+	for { set i 0 } { $i < $SPB } { incr i } {
 		append bl "--nil-- --nil-- --nil--\n"
 	}
 
@@ -379,7 +384,7 @@ proc out_put { t h v } {
 
 proc main { } {
 
-	global argv IFD OFD ILNUM CTS STA SMEXP LIMIT MORE TIMING MARKS
+	global argv IFD OFD ILNUM CTS STA SMEXP LIMIT MORE TIMING MARKS SPB
 	global LQO
 
 	set LQO 0
@@ -411,8 +416,15 @@ proc main { } {
 		err "the input file is empty"
 	}
 
-	if { [scan $ln "%lu %u %u %u %u %u %u %u %u" \
-	    tm op th lr rn ba ra co lm] != 9 } {
+	# the car size (codes per block) is absent in older files
+	set n [scan $ln "%lu %u %u %u %u %u %u %u %u %u" \
+	    tm op th lr rn ba ra co lm sp]
+	if { $n == 10 } {
+		if { $sp < 12 || $sp > 50 } {
+			err "bad block size in the header of the input file"
+		}
+		set SPB $sp
+	} elseif { $n != 9 } {
 		err "bad header in the input file"
 	}
 
@@ -426,6 +438,7 @@ proc main { } {
 	out_put "H" "Range" $rn
 	out_put "H" "Bandwidth" $ba
 	out_put "H" "Rate" $ra
+	out_put "H" "Block size" $SPB
 
 	set LIMIT $lm
 	set MORE 1
@@ -469,7 +482,7 @@ proc main { } {
 		set f 0.0
 	} else {
 		set f [expr { (double($TIMING(b) - $TIMING(a)) /
-			($TIMING(B) - $TIMING(A))) * 12000.0 }]
+			($TIMING(B) - $TIMING(A))) * $SPB * 1000.0 }]
 		set f [format %1.3f $f]
 	}
 
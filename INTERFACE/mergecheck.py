@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+# _*_ coding: ascii _*_
+
+#
+# Check of the merge mode (-m) of the native assembler: a streaming session
+# received by two pegs is simulated (cars lost independently at each peg,
+# lost ACKs, retransmissions, queue drops, mic blocks, marks), the raw
+# stream file of each peg is written as ossi.tcl would, and the assembler
+# is run on them:
+#
+#	merge (A, A) must produce the same output (text and binary) as A
+#	alone, except for the per-peg lines of the trailer
+#
+#	merge (A, B) must lose no more blocks than either A or B alone, and
+#	its rate and duration must be those of the session (as must be those
+#	of A and B alone)
+#
+# Usage: mergecheck.py [-S seed] [-t secs] [-l loss] [-x assembler]
+#
+# The exit code is 1 if any check fails.
+#
+
+import os
+import sys
+import re
+import random
+import tempfile
+import subprocess
+import argparse
+
+###############################################################################
+
+def abt (msg):
+	print (msg, file=sys.stderr);
+	exit (1);
+
+class Regs:
+	# the trailer of the cooked file
+	RATE = re.compile (r'^T: Rate: +([0-9.]+)', re.M)
+	LOST = re.compile (r'^T: Lost \(OSS/Peg\): +([0-9]+)', re.M)
+	TIME = re.compile (r'^T: Time: +([0-9]+) hours, ([0-9]+) minutes, '
+		r'([0-9]+) seconds', re.M)
+	PEG = re.compile (r'^T: Peg [0-9]+:.*\n', re.M)
+
+# session parameters
+SPB = 12		# codes per block
+BPERIOD = 15.0		# msecs between blocks
+TSPACE = 100		# msecs between trains
+TLENGTH = 32		# cars per train
+CSPACE = 2		# msecs between cars
+MAXQ = 96		# the Tag's queue limit
+AUDIO = 10		# every AUDIO-th block carries mic levels
+MARKS = 5000		# msecs between marks (on the average)
+
+def call_options ():
+
+	ps = argparse.ArgumentParser (
+		prog='mergecheck',
+		description='checks the merge mode of the native assembler',
+		epilog='')
+
+	ps.add_argument ("-S", "--seed", type=int, dest='seed', default=1,
+		help='random seed (default 1)')
+	ps.add_argument ("-t", "--time", type=int, dest='time', default=60,
+		help='session length in seconds (default 60)')
+	ps.add_argument ("-l", "--loss", type=float, dest='loss', default=0.2,
+		help='car loss rate at each peg (default 0.2)')
+	ps.add_argument ("-x", "--assembler", dest='asm',
+		default=os.path.join (os.path.dirname (
+			os.path.abspath (__file__)), 'assembler'),
+		help='the assembler (default: assembler next to this script)')
+
+	return ps.parse_args ()
+
+###############################################################################
+
+def session (rnd, secs, loss):
+#
+# Returns the lines (time, text) received by each of the two pegs
+#
+	tm = 1700000000000
+	pegs = ([], [])
+	# the pegs' host delays
+	dly = (3, 8)
+	pending = []
+	bn = 0
+	nblk = int (secs * 1000 / BPERIOD)
+	t = 1000
+	nmark = t + rnd.expovariate (1.0 / MARKS)
+	while bn < nblk or pending:
+		# the blocks generated since the last train
+		while bn < nblk and 1000 + (bn + 1) * BPERIOD <= t:
+			bn += 1
+			codes = ' '.join (f'{rnd.getrandbits (32):08X}'
+				for i in range (SPB))
+			pending.append ((bn, 'A' if bn % AUDIO == 0 else 'B',
+				codes))
+		# queue drops
+		if len (pending) > MAXQ:
+			del pending [:len (pending) - MAXQ]
+		if t >= nmark:
+			for k in range (2):
+				pegs [k].append ((t + dly [k],
+					f'M: {rnd.randint (1, 5)}'))
+			nmark = t + rnd.expovariate (1.0 / MARKS)
+		if not pending:
+			t += TSPACE
+			continue
+		rcvd = set ()
+		ct = t
+		for b, tp, codes in pending [:TLENGTH]:
+			for k in range (2):
+				if rnd.random () >= loss:
+					# reordered now and then
+					d = rnd.choice ((0, 0, 0, 0, 25))
+					pegs [k].append ((ct + dly [k] + d,
+						f'{tp}: {b} {codes}'))
+					rcvd.add (b)
+			ct += CSPACE
+		# the EOT: the last block, the offset of the oldest one
+		eot = f'E: {bn} {bn - pending [0][0] + 1} 3.09 00'
+		heard = False
+		for k in range (2):
+			if rnd.random () >= loss / 4:
+				pegs [k].append ((ct + dly [k], eot))
+				heard = True
+		if heard and rnd.random () >= loss / 4:
+			# the ACK
+			pending = [p for p in pending if p [0] not in rcvd]
+		t += TSPACE
+
+	hdr = f'{tm} 2 32 0 0 3 7 1 0 {SPB}'
+	out = []
+	for k in range (2):
+		l = sorted (pegs [k], key = lambda x: x [0])
+		out.append ([hdr] + [f'{x [0]} {x [1]}' for x in l])
+	return out, nblk
+
+def run (asm, args, d, name):
+#
+# Runs the assembler, returns the cooked file and the binary one
+#
+	cf = os.path.join (d, name + '.txt')
+	bf = os.path.join (d, name + '.bin')
+	try:
+		subprocess.run ([asm, '-b', bf] + args + [cf], check=True,
+			capture_output=True, timeout=600)
+	except Exception as ex:
+		abt (f'cannot run {asm}, {ex}')
+	with open (cf) as f:
+		c = f.read ()
+	with open (bf, 'rb') as f:
+		b = f.read ()
+	return c, b
+
+def figures (c):
+
+	r = float (Regs.RATE.search (c).group (1))
+	n = int (Regs.LOST.search (c).group (1))
+	m = Regs.TIME.search (c)
+	s = int (m.group (1)) * 3600 + int (m.group (2)) * 60 + \
+		int (m.group (3))
+	return r, n, s
+
+def check (name, ok, msg):
+
+	print (f'{name:36s} {msg} {"OK" if ok else "FAILED"}')
+	return ok
+
+###############################################################################
+
+def main ():
+
+	opts = call_options ()
+	rnd = random.Random (opts.seed)
+	caps, nblk = session (rnd, opts.time, opts.loss)
+	# the accel rate of the session and its duration (to the last block)
+	rate = SPB * 1000.0 / BPERIOD * (AUDIO - 1) / AUDIO
+	secs = int ((1000 + nblk * BPERIOD) / 1000)
+	ok = True
+
+	with tempfile.TemporaryDirectory () as d:
+		fa = os.path.join (d, 'a.raw')
+		fb = os.path.join (d, 'b.raw')
+		for fn, cp in ((fa, caps [0]), (fb, caps [1])):
+			with open (fn, 'w') as f:
+				f.write ('\n'.join (cp) + '\n')
+
+		ca, ba = run (opts.asm, [fa], d, 'a')
+		cb, bb = run (opts.asm, [fb], d, 'b')
+		caa, baa = run (opts.asm, ['-m', fa, fa], d, 'aa')
+		cab, bab = run (opts.asm, ['-m', fb, fa], d, 'ab')
+
+		ra, la, sa = figures (ca)
+		rb, lb, sb = figures (cb)
+		raa, laa, saa = figures (caa)
+		rab, lab, sab = figures (cab)
+
+		ok &= check ('merge (A, A) == A, text',
+			Regs.PEG.sub ('', caa) == ca,
+			f'rate {raa:.3f}/{ra:.3f}, lost {laa}/{la}')
+		ok &= check ('merge (A, A) == A, binary', baa == ba,
+			f'{len (baa)}/{len (ba)} bytes')
+		for n, r, l, s in (('A', ra, la, sa), ('B', rb, lb, sb),
+		    ('merge (A, B)', rab, lab, sab)):
+			ok &= check (f'{n}, rate and time',
+				abs (r - rate) < rate * 0.01 and
+				abs (s - secs) <= 1,
+				f'rate {r:.3f}/{rate:.3f}, {s}/{secs} s')
+		ok &= check ('merge (A, B), lost', lab <= min (la, lb),
+			f'{lab} (A {la}, B {lb})')
+
+	return 0 if ok else 1
+
+if __name__ == "__main__":
+	exit (main ())
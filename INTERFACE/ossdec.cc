@@ -0,0 +1,436 @@
+/*
+	Copyright 2002-2021 (C) Olsonet Communications Corporation
+	Programmed by Pawel Gburzynski
+	All rights reserved
+
+	This file is part of the PICOS platform
+
+*/
+
+//
+// Compiled decoder for the messages that arrive at high rates (streaming
+// blocks, EOTs) or take many small steps to decode in Tcl (sensor reports).
+// Loaded by ossi.tcl if present; otherwise ossi.tcl decodes the messages
+// itself with the same results.
+//
+// Build:	g++ -O2 -shared -fPIC -DUSE_TCL_STUBS -I/usr/include/tcl
+//			-o libossdec.so ossdec.cc -ltclstub8.6
+//
+// Commands (msg is the message payload, as passed to show_msg):
+//
+//	ossdec::sblock ref msg		-> { bn codes }
+//		bn is the full block number, codes is the string of the
+//		codes (12 to 50, as many as fit the message) as written to
+//		the stream file, i.e., " %08X" each; the same for mblock
+//
+//	ossdec::etrain msg		-> { last offset voltage flags sblock
+//					     sclock sfrac }
+//		voltage formatted as by sensor_to_voltage, flags as %02X,
+//		the time sync fields are zero if absent
+//
+//	ossdec::report msg raw		-> the text shown for the report
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <tcl.h>
+
+typedef	unsigned int		u32;
+typedef	unsigned short		u16;
+
+// The block number is spread over the first STRM_NCODES codes
+#define	STRM_NCODES	12
+#define	STRM_MAX_NCODES	50
+
+// ============================================================================
+
+struct rdr_t {
+//
+// Sequential little-endian reader over a message
+//
+	const unsigned char	*p, *e;
+
+	bool get (u32 &v, int n) {
+		if (e - p < n)
+			return false;
+		v = 0;
+		for (int i = n - 1; i >= 0; i--)
+			v = (v << 8) | p [i];
+		p += n;
+		return true;
+	}
+};
+
+static int too_short (Tcl_Interp *ip) {
+
+	Tcl_SetObjResult (ip, Tcl_NewStringObj ("blob too short", -1));
+	return TCL_ERROR;
+}
+
+static void voltage (char *b, size_t n, u32 v) {
+//
+// As sensor_to_voltage in ossi.tcl
+//
+	snprintf (b, n, "%4.2f", (double)((v >> 5) & 0xf) +
+		(double)(v & 0x1f) / 32.0);
+}
+
+// ============================================================================
+
+static int cmd_sblock (ClientData, Tcl_Interp *ip, int objc,
+							Tcl_Obj *const objv []) {
+	Tcl_Obj *res [2];
+	char fm [STRM_MAX_NCODES * 9 + 1], *f;
+	rdr_t r;
+	int n, nc, ref, sh;
+	Tcl_WideInt bn;
+	u32 c;
+
+	if (objc != 3) {
+		Tcl_WrongNumArgs (ip, 1, objv, "ref msg");
+		return TCL_ERROR;
+	}
+
+	if (Tcl_GetIntFromObj (ip, objv [1], &ref) != TCL_OK)
+		return TCL_ERROR;
+
+	r . p = Tcl_GetByteArrayFromObj (objv [2], &n);
+	r . e = r . p + n;
+
+	// the car size: the codes that fit (the RSSI follows them)
+	if ((nc = n / 4) < STRM_NCODES)
+		return too_short (ip);
+	if (nc > STRM_MAX_NCODES)
+		nc = STRM_MAX_NCODES;
+
+	// the low byte of the block number is in ref, the rest comes in
+	// the two least significant bits of the (first 12) codes
+	bn = ref & 0xff;
+	sh = 8;
+	f = fm;
+	for (int i = 0; i < nc; i++, sh += 2) {
+		if (!r . get (c, 4))
+			return too_short (ip);
+		f += sprintf (f, " %08X", c);
+		if (i < STRM_NCODES)
+			bn |= (Tcl_WideInt)(c & 0x3) << sh;
+	}
+
+	res [0] = Tcl_NewWideIntObj (bn);
+	res [1] = Tcl_NewStringObj (fm, f - fm);
+	Tcl_SetObjResult (ip, Tcl_NewListObj (2, res));
+	return TCL_OK;
+}
+
+static int cmd_etrain (ClientData, Tcl_Interp *ip, int objc,
+							Tcl_Obj *const objv []) {
+	Tcl_Obj *res [7];
+	char b [16];
+	rdr_t r;
+	int n;
+	u32 last, offset, volt, flags, sblock, sclock, sfrac;
+
+	if (objc != 2) {
+		Tcl_WrongNumArgs (ip, 1, objv, "msg");
+		return TCL_ERROR;
+	}
+
+	r . p = Tcl_GetByteArrayFromObj (objv [1], &n);
+	r . e = r . p + n;
+
+	if (!r . get (last, 4) || !r . get (offset, 2) || !r . get (volt, 1) ||
+	    !r . get (flags, 1))
+		return too_short (ip);
+
+	// The time sync fields (absent in older EOTs)
+	if (!r . get (sblock, 4) || !r . get (sclock, 4) ||
+	    !r . get (sfrac, 2))
+		sblock = sclock = sfrac = 0;
+
+	res [0] = Tcl_NewWideIntObj ((Tcl_WideInt) last);
+	res [1] = Tcl_NewIntObj ((int) offset);
+	voltage (b, sizeof (b), volt);
+	res [2] = Tcl_NewStringObj (b, -1);
+	snprintf (b, sizeof (b), "%02X", flags);
+	res [3] = Tcl_NewStringObj (b, -1);
+	res [4] = Tcl_NewWideIntObj ((Tcl_WideInt) sblock);
+	res [5] = Tcl_NewWideIntObj ((Tcl_WideInt) sclock);
+	res [6] = Tcl_NewIntObj ((int) sfrac);
+	Tcl_SetObjResult (ip, Tcl_NewListObj (7, res));
+	return TCL_OK;
+}
+
+// ============================================================================
+// Reports: the same formats as the get_xxx procedures in ossi.tcl
+// ============================================================================
+
+static bool raw;
+
+static bool f16 (rdr_t &r, std::string &s) {
+
+	char b [16];
+	u32 w;
+
+	if (!r . get (w, 2))
+		return false;
+	if (raw)
+		snprintf (b, sizeof (b), "%04x", w);
+	else
+		snprintf (b, sizeof (b), "%7.4f", (double)(short) w / 32768.0);
+	s += b;
+	return true;
+}
+
+static bool t16 (rdr_t &r, std::string &s) {
+
+	char b [16];
+	u32 w;
+
+	if (!r . get (w, 2))
+		return false;
+	if (raw)
+		snprintf (b, sizeof (b), "%04x", w);
+	else
+		snprintf (b, sizeof (b), "%7.2f", (double)(short) w / 10.0);
+	s += b;
+	return true;
+}
+
+static bool t32 (rdr_t &r, std::string &s) {
+
+	char b [24];
+	u32 w;
+
+	if (!r . get (w, 4))
+		return false;
+	if (raw)
+		snprintf (b, sizeof (b), "%08x", w);
+	else
+		snprintf (b, sizeof (b), "%7.2f", (double)(int) w / 100.0);
+	s += b;
+	return true;
+}
+
+static bool i16 (rdr_t &r, std::string &s) {
+
+	char b [16];
+	u32 w;
+
+	if (!r . get (w, 2))
+		return false;
+	if (raw)
+		snprintf (b, sizeof (b), "%04x", w);
+	else
+		snprintf (b, sizeof (b), "%6d", (int)(short) w);
+	s += b;
+	return true;
+}
+
+static bool n16 (rdr_t &r, std::string &s) {
+
+	char b [16];
+	u32 w;
+
+	if (!r . get (w, 2))
+		return false;
+	snprintf (b, sizeof (b), raw ? "%04x" : "%5u", w);
+	s += b;
+	return true;
+}
+
+static bool n32 (rdr_t &r, std::string &s) {
+
+	char b [16];
+	u32 w;
+
+	if (!r . get (w, 4))
+		return false;
+	snprintf (b, sizeof (b), raw ? "%08x" : "%11u", w);
+	s += b;
+	return true;
+}
+
+static bool e16 (rdr_t &r, std::string &s) {
+
+	char b [24];
+	u32 w;
+
+	if (!r . get (w, 2))
+		return false;
+	if (raw)
+		snprintf (b, sizeof (b), "%04x", w);
+	else
+		snprintf (b, sizeof (b), "%8.2e", (double)(w & 0x0fff) *
+			pow (2.0, (double)((w >> 12) & 0xf)));
+	s += b;
+	return true;
+}
+
+static bool xyz (rdr_t &r, std::string &s, const char *t) {
+
+	s += " [";
+	s += t;
+	for (int i = 0; i < 3; i++) {
+		s += ' ';
+		if (!f16 (r, s))
+			return false;
+	}
+	s += ']';
+	return true;
+}
+
+static bool report (rdr_t &r, std::string &s) {
+//
+// Decode the report, see show_msg_report in ossi.tcl for the layout
+//
+	u32 sample, layout, size, cmp;
+	char b [32];
+
+	if (!r . get (sample, 2) || !r . get (layout, 2) || !r . get (size, 2))
+		return false;
+
+	// the blob
+	if (r . e - r . p < (int) size)
+		return false;
+	r . e = r . p + size;
+
+	snprintf (b, sizeof (b), "%u ", sample);
+	s = b;
+
+	if ((cmp = layout & 0x1f) != 0) {
+		s += " IMU:";
+		if (cmp & 0x10) {
+			s += " [M ";
+			if (!n16 (r, s))
+				return false;
+			s += ']';
+		} else {
+			if ((cmp & 0x01) && !xyz (r, s, "A"))
+				return false;
+			if ((cmp & 0x02) && !xyz (r, s, "G"))
+				return false;
+			if ((cmp & 0x04) && !xyz (r, s, "C"))
+				return false;
+			if (cmp & 0x08) {
+				s += " [T ";
+				if (!i16 (r, s))
+					return false;
+				s += ']';
+			}
+		}
+	}
+
+	if ((layout >> 7) & 0x1) {
+		s += " MIC: [SA ";
+		if (!n32 (r, s))
+			return false;
+		s += ' ';
+		if (!n32 (r, s))
+			return false;
+		s += ']';
+	}
+
+	if ((cmp = (layout >> 9) & 0x3) != 0) {
+		s += " PRE:";
+		if (cmp & 0x01) {
+			s += " [P ";
+			if (!n32 (r, s))
+				return false;
+			s += ']';
+		}
+		if (cmp & 0x02) {
+			s += " [T ";
+			if (!t32 (r, s))
+				return false;
+			s += ']';
+		}
+	}
+
+	if ((cmp = (layout >> 5) & 0x3) != 0) {
+		s += " HUM:";
+		if (cmp & 0x02) {
+			s += " [T ";
+			if (!t16 (r, s))
+				return false;
+			s += ']';
+		}
+		if (cmp & 0x01) {
+			s += " [H ";
+			if (!t16 (r, s))
+				return false;
+			s += ']';
+		}
+	}
+
+	if ((layout >> 8) & 0x1) {
+		s += " LIG: [";
+		if (!e16 (r, s))
+			return false;
+		s += ']';
+	}
+
+	if ((layout >> 11) & 0x1) {
+		static const char *an [] = { "R", "W", "T", "U" };
+		u32 t;
+		s += " ACT:";
+		for (int i = 0; i < 4; i++) {
+			if (!r . get (t, 4))
+				return false;
+			snprintf (b, sizeof (b), " %s %1.1f", an [i],
+				(double) t / 1000.0);
+			s += b;
+		}
+		s += " [S ";
+		if (!n16 (r, s))
+			return false;
+		s += ']';
+	}
+
+	return true;
+}
+
+static int cmd_report (ClientData, Tcl_Interp *ip, int objc,
+							Tcl_Obj *const objv []) {
+	std::string s;
+	rdr_t r;
+	int n, rw;
+
+	if (objc != 3) {
+		Tcl_WrongNumArgs (ip, 1, objv, "msg raw");
+		return TCL_ERROR;
+	}
+
+	if (Tcl_GetBooleanFromObj (ip, objv [2], &rw) != TCL_OK)
+		return TCL_ERROR;
+
+	raw = rw != 0;
+	r . p = Tcl_GetByteArrayFromObj (objv [1], &n);
+	r . e = r . p + n;
+
+	if (!report (r, s))
+		return too_short (ip);
+
+	Tcl_SetObjResult (ip, Tcl_NewStringObj (s . data (), s . size ()));
+	return TCL_OK;
+}
+
+// ============================================================================
+
+extern "C" int Ossdec_Init (Tcl_Interp *ip) {
+
+#ifdef USE_TCL_STUBS
+	if (Tcl_InitStubs (ip, "8.5", 0) == NULL)
+		return TCL_ERROR;
+#endif
+	if (Tcl_FindNamespace (ip, "::ossdec", NULL, 0) == NULL &&
+	    Tcl_CreateNamespace (ip, "::ossdec", NULL, NULL) == NULL)
+		return TCL_ERROR;
+
+	Tcl_CreateObjCommand (ip, "ossdec::sblock", cmd_sblock, NULL, NULL);
+	Tcl_CreateObjCommand (ip, "ossdec::etrain", cmd_etrain, NULL, NULL);
+	Tcl_CreateObjCommand (ip, "ossdec::report", cmd_report, NULL, NULL);
+
+	return Tcl_PkgProvide (ip, "ossdec", "1.0");
+}
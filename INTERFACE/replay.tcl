@@ -0,0 +1,387 @@
+#!/bin/sh
+#
+#	Copyright 2002-2021 (C) Olsonet Communications Corporation
+#	Programmed by Pawel Gburzynski & Wlodek Olesinski
+#	All rights reserved
+#
+#	This file is part of the PICOS platform
+#
+########\
+exec tclsh "$0" "$@"
+
+#
+# Replays a frame capture (stream -frames file in ossi.tcl) through the host
+# pipeline:
+#
+#	decode		the message handlers of ossi.tcl (with the compiled
+#			decoder if built), producing the raw stream file
+#	assemble	the assembler (native if built, else assembler.tcl)
+#	analyze		analyze.py in batch mode (only with -analyze)
+#
+# and reports the time spent in each stage, the throughput, and the CRC32
+# checksums of the outputs. The frames are fed as fast as possible, or
+# (with -realtime) at their original timing.
+#
+# Usage:
+#
+#	replay.tcl [-realtime] [-analyze] [-verbose] [-o dir]
+#		[-assembler command] [-expect crc] framefile
+#
+# With -expect, the exit code is 1 if the checksum of the cooked output is
+# different (a regression in decoding or loss accounting).
+#
+
+set DIR [file dirname [file normalize [info script]]]
+
+proc err { m } {
+
+	puts stderr $m
+	exit 1
+}
+
+proc usage { } {
+
+	err "usage: replay.tcl \[-realtime\] \[-analyze\] \[-verbose\]\
+		\[-o dir\] \[-assembler command\] \[-expect crc\] framefile"
+}
+
+###############################################################################
+# Stand-ins for the OSS framework, enough for the message handlers
+###############################################################################
+
+proc oss_interface { args } { }
+
+proc oss_command { args } { }
+
+proc oss_issuecommand { args } { }
+
+proc oss_setvalues { args } {
+
+	return ""
+}
+
+proc oss_ttyout { msg } {
+
+	global PAR
+
+	if $PAR(V) {
+		puts $msg
+	}
+}
+
+proc oss_message { name code def } {
+#
+# Keep the layout: a list of { type name count }, count == 0 means scalar
+#
+	global MSTRUCT MCODE
+
+	set fl ""
+	foreach ln [split $def "\n;"] {
+		set ln [string trim $ln]
+		if { $ln == "" || [string index $ln 0] == "#" } {
+			continue
+		}
+		if ![regexp {^(byte|word|lword|blob)[[:space:]]+([[:alnum:]_]+)(\[([[:digit:]]+)\])?} \
+		    [regsub -all {[[:space:]]+\[} $ln {[}] ma tp nm ar cn] {
+			err "unsupported field in message $name: $ln"
+		}
+		if { $cn == "" } {
+			set cn 0
+		}
+		lappend fl [list $tp $nm $cn]
+	}
+
+	set MSTRUCT($name) $fl
+	set MCODE([expr { $code }]) $name
+}
+
+proc oss_getmsgstruct { code nm } {
+
+	global MCODE MSTRUCT
+
+	upvar $nm name
+
+	if ![info exists MCODE($code)] {
+		return ""
+	}
+
+	set name $MCODE($code)
+	return $MSTRUCT($name)
+}
+
+proc oss_getvalues { msg name } {
+#
+# Little endian, words aligned at 2, lwords at 4 (as in the node's structs)
+#
+	global MSTRUCT
+
+	set res ""
+	set off 0
+	set len [string length $msg]
+
+	foreach f $MSTRUCT($name) {
+		lassign $f tp nm cn
+		set n [expr { $cn ? $cn : 1 }]
+		switch $tp {
+			"byte"	{ set sz 1; set fm "cu" }
+			"word"	{ set sz 2; set fm "su" }
+			"lword"	{ set sz 4; set fm "iu" }
+			"blob"	{ set sz 2; set fm "su" }
+		}
+		set off [expr { ($off + $sz - 1) & ~($sz - 1) }]
+		if { $off + $sz * $n > $len } {
+			error "message too short"
+		}
+		if { $tp == "blob" } {
+			binary scan $msg "@${off}su" bl
+			incr off 2
+			if { $off + $bl > $len } {
+				error "message too short"
+			}
+			binary scan $msg "@${off}cu$bl" v
+			incr off $bl
+		} else {
+			binary scan $msg "@${off}$fm$n" v
+			incr off [expr { $sz * $n }]
+		}
+		lappend res $v
+	}
+
+	return $res
+}
+
+###############################################################################
+
+proc crc { fn } {
+
+	if [catch { open $fn "r" } fd] {
+		return "--------"
+	}
+	fconfigure $fd -translation binary
+	set c [zlib crc32 [read $fd]]
+	close $fd
+
+	return [format %08x $c]
+}
+
+proc trailer { fn tag } {
+#
+# A statistics line from the cooked output
+#
+	if [catch { open $fn "r" } fd] {
+		return ""
+	}
+	set res ""
+	while { [gets $fd ln] >= 0 } {
+		if [regexp "^T: $tag:\[ \]+(.*)" $ln ma res] {
+			break
+		}
+	}
+	close $fd
+
+	return $res
+}
+
+proc stage { name t what } {
+
+	puts [format "%-12s %10.3f s   %s" $name [expr { $t / 1000000.0 }] $what]
+}
+
+proc run { cmd } {
+#
+# Execute a stage, return its time in usecs
+#
+	set t [clock microseconds]
+	if [catch { exec {*}$cmd 2>@1 } res] {
+		err "[lindex $cmd 0] failed: $res"
+	}
+	return [expr { [clock microseconds] - $t }]
+}
+
+###############################################################################
+
+proc replay { ffn rfn } {
+#
+# The decode stage; returns { frames time mean max }
+#
+	global PAR REPLAY StrFD CPARAMS
+
+	if [catch { open $ffn "r" } fd] {
+		err "cannot open $ffn, $fd"
+	}
+
+	if { [gets $fd hd] < 0 } {
+		err "the frame file is empty"
+	}
+
+	if { [scan $hd "%lu %u %u %u %u %u %u %u %u" tm op th lr rn ba ra \
+	    co lm] != 9 } {
+		err "bad header in the frame file"
+	}
+
+	if [catch { open $rfn "w" } StrFD] {
+		err "cannot open $rfn, $StrFD"
+	}
+	fconfigure $StrFD -buffering full -translation lf
+	puts $StrFD $hd
+
+	set CPARAMS(0,L) $lm
+	set CPARAMS(0,B) 0
+
+	set nf 0
+	set tt 0
+	set mx 0
+	set ln 1
+	set st [clock milliseconds]
+
+	while { [gets $fd line] >= 0 } {
+		incr ln
+		if ![regexp {^([[:digit:]]+) (.): (.*)} $line ma ms tp line] {
+			err "bad line $ln in the frame file"
+		}
+		set REPLAY(ms) $ms
+		if $PAR(R) {
+			set d [expr { $st + $ms - [clock milliseconds] }]
+			if { $d > 0 } {
+				after $d
+			}
+		}
+		if { $tp == "M" } {
+			if { $StrFD != "" } {
+				puts $StrFD "$ms M: $line"
+			}
+			continue
+		}
+		if { $tp != "F" || [scan $line "%u %u %s" code ref hx] != 3 } {
+			err "bad frame in line $ln"
+		}
+		set t [clock microseconds]
+		if [catch { show_msg $code $ref [binary decode hex $hx] } er] {
+			# as the OSS framework does, just report
+			oss_ttyout "frame $ln: $er"
+		}
+		set t [expr { [clock microseconds] - $t }]
+		incr tt $t
+		if { $t > $mx } {
+			set mx $t
+		}
+		incr nf
+	}
+
+	close $fd
+	if { $StrFD != "" } {
+		# not closed by issue_stop (on reaching the limit)
+		close $StrFD
+		set StrFD ""
+	}
+
+	return [list $nf [expr { ([clock milliseconds] - $st) * 1000 }] \
+		[expr { $nf ? $tt / double ($nf) : 0.0 }] $mx]
+}
+
+proc main { } {
+
+	global argv PAR REPLAY DIR
+
+	set PAR(R) 0
+	set PAR(A) 0
+	set PAR(V) 0
+	set PAR(O) "."
+	set PAR(C) ""
+	set PAR(E) ""
+
+	set ffn ""
+
+	while { $argv != "" } {
+		set a [lindex $argv 0]
+		set argv [lrange $argv 1 end]
+		switch -- $a {
+			"-realtime"	{ set PAR(R) 1 }
+			"-analyze"	{ set PAR(A) 1 }
+			"-verbose"	{ set PAR(V) 1 }
+			"-o" - "-assembler" - "-expect" {
+				if { $argv == "" } {
+					usage
+				}
+				set PAR([dict get { -o O -assembler C -expect E } \
+					$a]) [lindex $argv 0]
+				set argv [lrange $argv 1 end]
+			}
+			default {
+				if { $ffn != "" || [string index $a 0] == "-" } {
+					usage
+				}
+				set ffn $a
+			}
+		}
+	}
+
+	if { $ffn == "" } {
+		usage
+	}
+
+	if [catch { file mkdir $PAR(O) } er] {
+		err "cannot create $PAR(O), $er"
+	}
+
+	set bn [file join $PAR(O) [file rootname [file tail $ffn]]]
+	set rfn "${bn}.raw"
+	set cfn "${bn}.cooked"
+
+	# the message handlers
+	set REPLAY(ms) 0
+	uplevel #0 [list source [file join [file dirname $DIR] ossi.tcl]]
+	proc timing { } {
+		global REPLAY
+		return $REPLAY(ms)
+	}
+
+	if { $PAR(C) == "" } {
+		set PAR(C) [file join $DIR assembler]
+		if ![file executable $PAR(C)] {
+			set PAR(C) [list [info nameofexecutable] \
+				[file join $DIR assembler.tcl]]
+		}
+	}
+
+	lassign [replay $ffn $rfn] nf tt av mx
+	stage "decode" $tt "$nf frames,\
+		[format %1.0f [expr { $tt ? $nf * 1000000.0 / $tt : 0 }]]/s,\
+		[format %1.1f $av] us mean, $mx us max per frame\
+		[expr { $::OSSDEC ? "(compiled)" : "(Tcl)" }]"
+
+	set t [run [concat $PAR(C) [list $rfn $cfn]]]
+	set nb [trailer $cfn "Total blocks"]
+	if { $nb == "" } {
+		set nb 0
+	}
+	stage "assemble" $t "$nb blocks,\
+		[format %1.0f [expr { $t ? $nb * 1000000.0 / $t : 0 }]]/s"
+
+	if $PAR(A) {
+		set mfn "${bn}.manifest"
+		set fd [open $mfn "w"]
+		puts $fd [file normalize $cfn]
+		close $fd
+		set t [run [list python3 [file join $DIR analyze.py] -b $mfn \
+			-j 1 -o $PAR(O) -s "${bn}.summary"]]
+		stage "analyze" $t ""
+	}
+
+	puts "Lost (OSS/Peg):    [lindex [trailer $cfn {Lost \(OSS/Peg\)}] 0]\
+		[lindex [trailer $cfn {Lost \(OSS/Peg\)}] 1]"
+	puts "Duplicate:         [trailer $cfn Duplicate]"
+	puts "Raw checksum:      [crc $rfn]"
+	if $PAR(A) {
+		puts "Summary:           [crc ${bn}.summary]"
+	}
+	set cs [crc $cfn]
+	puts "Checksum:          $cs"
+
+	if { $PAR(E) != "" && [string tolower $PAR(E)] != $cs } {
+		puts "MISMATCH, expected $PAR(E)"
+		exit 1
+	}
+}
+
+main
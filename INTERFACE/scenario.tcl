@@ -0,0 +1,531 @@
+#!/bin/sh
+#
+#	Copyright 2002-2021 (C) Olsonet Communications Corporation
+#	Programmed by Pawel Gburzynski & Wlodek Olesinski
+#	All rights reserved
+#
+#	This file is part of the PICOS platform
+#
+########\
+exec tclsh "$0" "$@"
+
+#
+# Multi-node VUEE scenarios: N tags streaming to M pegs at mixed rates and
+# distances over the tabulated channel (VUEEDATA/CHANNEL).
+#
+#	scenario.tcl generate [-tags n] [-pegs m] [-spacing meters]
+#		[-distance min:max] [-rates div,div,...] [-tdma msecs]
+#		[-seed s] [-o dir]
+#
+# writes dir/data.xml (to be used instead of VUEEDATA/data.xml) and
+# dir/scenario.txt describing the nodes, and prints the commands to issue
+# at each peg. A peg serves exactly one tag (its OSS commands reach every
+# tag of its group, and pegstream.cc keeps the state of a single stream),
+# so tag i goes to peg i; -pegs defaults to -tags, fewer pegs than tags is
+# an error, extra pegs stay idle. A peg and its tag form a group (the upper
+# half of host_id) that determines the SID and the channel (group & 7), so
+# with more than 8 pegs the channels are shared. Each tag is placed at a
+# random distance from its peg and the streaming rates (the imu rate
+# divisors) are picked from the list in turn. With -tdma, every channel
+# shared by several pegs gets a
+# coordinator (a peg of its own, in a free group on the channel) to issue
+# the tdma command with the given cycle, giving each group a slot.
+#
+#	scenario.tcl summarize [-d dir] scenario.txt
+#
+# reads the stream files (ossi.tcl: stream -file) dir/tag_HHHHHHHH.raw,
+# one per tag (HHHHHHHH = the tag's host_id), and optionally the OSS
+# console logs dir/tag_HHHHHHHH.log (for the queue drop count of the last
+# status report), and prints goodput, loss, duplicates, latency and queue
+# drops per tag, plus the totals per channel.
+#
+
+proc err { m } {
+
+	puts stderr $m
+	exit 1
+}
+
+proc usage { } {
+
+	err "usage: scenario.tcl generate \[-tags n\] \[-pegs m\]\
+		\[-spacing meters\] \[-distance min:max\] \[-rates div,...\]\
+		\[-tdma msecs\] \[-seed s\] \[-o dir\]\n       scenario.tcl summarize \[-d dir\]\
+		scenario.txt"
+}
+
+proc args { al } {
+#
+# Parse -option value pairs, returns the list of remaining arguments
+#
+	global PAR argv
+
+	set res ""
+
+	while { $argv != "" } {
+		set a [lindex $argv 0]
+		set argv [lrange $argv 1 end]
+		if { [string index $a 0] != "-" } {
+			lappend res $a
+			continue
+		}
+		if { ![dict exists $al $a] || $argv == "" } {
+			usage
+		}
+		set PAR([dict get $al $a]) [lindex $argv 0]
+		set argv [lrange $argv 1 end]
+	}
+
+	return $res
+}
+
+proc rnd { } {
+#
+# Repeatable (for the same seed) on all platforms
+#
+	global RSEED
+
+	set RSEED [expr { ($RSEED * 1103515245 + 12345) & 0x7fffffff }]
+	return [expr { ($RSEED >> 7) / double (0x1000000) }]
+}
+
+###############################################################################
+# Generator
+###############################################################################
+
+proc generate { } {
+
+	global PAR RSEED
+
+	set PAR(N) 4
+	set PAR(M) ""
+	set PAR(S) 20.0
+	set PAR(D) "1:10"
+	set PAR(R) "7,3,1"
+	set PAR(T) 0
+	set PAR(E) 1
+	set PAR(O) "."
+
+	if { [args { -tags N -pegs M -spacing S -distance D -rates R -tdma T
+	    -seed E -o O }] != "" } {
+		usage
+	}
+
+	if { [catch { expr { int ($PAR(T)) } } tc] || $tc < 0 || $tc > 65534 } {
+		err "illegal -tdma, must be the cycle in msecs"
+	}
+
+	if { $PAR(M) == "" } {
+		# one peg per tag
+		set PAR(M) $PAR(N)
+	}
+
+	if { [catch { expr { int ($PAR(N)) } } nt] || $nt < 1 ||
+	     [catch { expr { int ($PAR(M)) } } np] || $np < 1 || $np > 0xfffe } {
+		err "illegal -tags or -pegs"
+	}
+
+	if { $nt > $np } {
+		err "more tags than pegs, a peg serves one tag"
+	}
+
+	if { [scan $PAR(D) "%f:%f" dmin dmax] != 2 || $dmin < 0.1 ||
+	    $dmax < $dmin } {
+		err "illegal -distance, must be min:max (meters)"
+	}
+
+	if { [catch { expr { double ($PAR(S)) } } sp] || $sp < 0.0 } {
+		err "illegal -spacing"
+	}
+
+	set rl ""
+	foreach r [split $PAR(R) ","] {
+		if { [catch { expr { int ($r) } } r] || $r < 0 || $r > 255 } {
+			err "illegal -rates, must be imu rate divisors 0-255"
+		}
+		lappend rl $r
+	}
+
+	set RSEED [expr { $PAR(E) & 0x7fffffff }]
+
+	if [catch { file mkdir $PAR(O) } er] {
+		err "cannot create $PAR(O), $er"
+	}
+
+	# the pegs on a line, PAR(S) meters apart
+	set nodes ""
+	for { set g 1 } { $g <= $np } { incr g } {
+		set px($g) [expr { 10.0 + ($g - 1) * $sp }]
+		set py($g) 10.0
+		set nx($g) 1
+		lappend nodes [list peg [expr { ($g << 16) | 1 }] $g $px($g) \
+			$py($g) 0.0 "-"]
+	}
+
+	# the tags next to them, one per peg
+	for { set i 0 } { $i < $nt } { incr i } {
+		set g [expr { $i + 1 }]
+		set d [expr { $dmin + ($dmax - $dmin) * [rnd] }]
+		set a [expr { 6.283185307179586 * [rnd] }]
+		lappend nodes [list tag [expr { ($g << 16) | [incr nx($g)] }] \
+			$g [expr { $px($g) + $d * cos ($a) }] \
+			[expr { $py($g) + $d * sin ($a) }] $d \
+			[lindex $rl [expr { $i % [llength $rl] }]]]
+	}
+
+	# the coordinators: the groups of a channel get the slots in order
+	if $tc {
+		for { set g 1 } { $g <= $np } { incr g } {
+			lappend chg([expr { $g & 7 }]) $g
+		}
+		foreach ch [lsort -integer [array names chg]] {
+			set gl $chg($ch)
+			set n [llength $gl]
+			if { $n < 2 } {
+				continue
+			}
+			if { $n > 8 } {
+				err "$n pegs on channel $ch, at most 8 can be\
+					scheduled"
+			}
+			# as in osscmn.h: STRM_TDMA_GUARD, 2 * STRM_TDMA_TAIL
+			if { ($tc - 8) / $n < 128 } {
+				err "-tdma $tc too short for $n slots, must be\
+					at least [expr { 128 * $n + 8 }]"
+			}
+			# the first free group on the channel, amid its pegs
+			set cg [expr { (($np >> 3) + 1) * 8 + $ch }]
+			set x 0.0
+			foreach g $gl {
+				set x [expr { $x + $px($g) }]
+			}
+			lappend nodes [list peg [expr { ($cg << 16) | 1 }] $cg \
+				[expr { $x / $n }] 5.0 0.0 "-"]
+			set cmd($cg) [list "tdma -cycle $tc -groups [join $gl ,]"]
+			lappend crd $cg
+		}
+	}
+
+	# data.xml
+	set fn [file join $PAR(O) data.xml]
+	if [catch { open $fn "w" } fd] {
+		err "cannot open $fn, $fd"
+	}
+
+	puts $fd "<network nodes=\"[llength $nodes]\">"
+	puts $fd "    <grid>0.1m</grid>"
+	puts $fd "    <tolerance quality=\"2\">1E-4</tolerance>"
+	puts $fd "    <xi:include href=\"VUEEDATA/CHANNEL/tabulated.xml\"/>"
+	puts $fd "    <nodes>"
+	foreach n $nodes {
+		lassign $n tp hid
+		puts $fd "\t<node type=\"$tp\" hid=\"[format 0x%08X $hid]\"\
+			default=\"board\">"
+		if { $tp == "peg" } {
+			puts $fd "\t    <uart rate=\"115200\" mode=\"n\">"
+			puts $fd "\t\t<input source=\"socket\"></input>"
+			puts $fd "\t\t<output target=\"socket\"></output>"
+			puts $fd "\t    </uart>"
+		}
+		puts $fd "\t    <emul><output target=\"socket\"/></emul>"
+		puts $fd "\t</node>"
+	}
+	puts $fd "        <locations>"
+	foreach n $nodes {
+		lassign $n tp hid g x y
+		puts $fd "\t    <location movable=\"yes\">\
+			[format %1.1f $x] [format %1.1f $y] </location>"
+	}
+	puts $fd "        </locations>"
+	puts $fd "    </nodes>"
+	puts $fd "</network>"
+	close $fd
+
+	# scenario.txt
+	set fn [file join $PAR(O) scenario.txt]
+	if [catch { open $fn "w" } fd] {
+		err "cannot open $fn, $fd"
+	}
+
+	puts $fd "# scenario.tcl generate -tags $PAR(N) -pegs $PAR(M)\
+		-spacing $PAR(S) -distance $PAR(D) -rates $PAR(R)\
+		-seed $PAR(E)"
+	puts $fd "# node hid group channel x y distance rate"
+	foreach n $nodes {
+		lassign $n tp hid g x y d r
+		puts $fd "$tp [format %08X $hid] $g [expr { $g & 7 }]\
+			[format %1.1f $x] [format %1.1f $y] [format %1.2f $d] $r"
+		if { $tp == "tag" } {
+			# the commands for the peg's OSS session
+			lappend cmd($g) "stream -rate $r -file\
+				tag_[format %08X $hid].raw"
+		}
+	}
+	close $fd
+
+	for { set g 1 } { $g <= $np } { incr g } {
+		puts "Peg [format %08X [expr { ($g << 16) | 1 }]] (node\
+			[expr { $g - 1 }], channel [expr { $g & 7 }]):"
+		if ![info exists cmd($g)] {
+			puts "    (no tags)"
+			continue
+		}
+		foreach c $cmd($g) {
+			puts "    $c"
+		}
+	}
+
+	if ![info exists crd] {
+		return
+	}
+
+	foreach g $crd {
+		puts "Coordinator [format %08X [expr { ($g << 16) | 1 }]] (node\
+			[lsearch -index 2 $nodes $g], channel [expr { $g & 7 }]):"
+		puts "    [lindex $cmd($g) 0]"
+	}
+}
+
+###############################################################################
+# Summarizer
+###############################################################################
+
+proc percentile { l p } {
+
+	set l [lsort -real $l]
+	set n [llength $l]
+	if { $n == 0 } {
+		return 0.0
+	}
+	set i [expr { int (ceil ($p * $n)) - 1 }]
+	if { $i < 0 } {
+		set i 0
+	}
+	return [lindex $l $i]
+}
+
+proc capture { fn } {
+#
+# Stats from a stream file: { blocks lost dups duration eots qdrflags
+# pegloss latmean latp95 }
+#
+	if [catch { open $fn "r" } fd] {
+		return ""
+	}
+
+	if { [gets $fd hd] < 0 } {
+		close $fd
+		return ""
+	}
+
+	set nd 0
+	set ne 0
+	set nq 0
+	set pl 0
+	set t0 ""
+	set t1 0
+	set bmin ""
+	set bmax 0
+	array unset BN
+
+	while { [gets $fd ln] >= 0 } {
+		if ![regexp {^([[:digit:]]+) (.): ([[:digit:]]+)(.*)} $ln \
+		    ma ms tp bn rest] {
+			continue
+		}
+		if { $tp == "E" } {
+			incr ne
+			if { [scan $rest "%u %s %x" of vo fl] == 3 } {
+				if { $fl & 4 } {
+					incr nq
+				}
+				incr pl [expr { $fl >> 4 }]
+			}
+			continue
+		}
+		if { $tp != "B" && $tp != "A" } {
+			continue
+		}
+		if [info exists BN($bn)] {
+			incr nd
+			continue
+		}
+		set BN($bn) $ms
+		if { $t0 == "" } {
+			set t0 $ms
+		}
+		set t1 $ms
+		if { $bmin == "" || $bn < $bmin } {
+			set bmin $bn
+		}
+		if { $bn > $bmax } {
+			set bmax $bn
+		}
+	}
+
+	close $fd
+
+	set nb [array size BN]
+	if { $nb == 0 } {
+		return [list 0 0 $nd 0 $ne $nq $pl 0.0 0.0]
+	}
+
+	# latency relative to the earliest possible delivery: the block
+	# period from the span, the offset of each block from the nominal
+	# schedule minus the smallest offset
+	set lt ""
+	if { $bmax > $bmin } {
+		set pe [expr { ($BN($bmax) - $BN($bmin)) /
+			double ($bmax - $bmin) }]
+		set mo ""
+		foreach bn [array names BN] {
+			set o [expr { $BN($bn) - $bn * $pe }]
+			lappend lt $o
+			if { $mo == "" || $o < $mo } {
+				set mo $o
+			}
+		}
+		set sl 0.0
+		set l ""
+		foreach o $lt {
+			lappend l [expr { $o - $mo }]
+			set sl [expr { $sl + $o - $mo }]
+		}
+		set lt $l
+		set lm [expr { $sl / [llength $lt] }]
+	} else {
+		set lm 0.0
+	}
+
+	return [list $nb [expr { $bmax - $bmin + 1 - $nb }] $nd \
+		[expr { ($t1 - $t0) / 1000.0 }] $ne $nq $pl $lm \
+		[percentile $lt 0.95]]
+}
+
+proc status_qdrops { fn } {
+#
+# The queue drop count from the last status report in a console log
+#
+	if [catch { open $fn "r" } fd] {
+		return "-"
+	}
+	set qd "-"
+	while { [gets $fd ln] >= 0 } {
+		regexp {SStats:.* Q: ([[:digit:]]+)} $ln ma qd
+	}
+	close $fd
+	return $qd
+}
+
+proc summarize { } {
+
+	global PAR
+
+	set PAR(D) "."
+
+	set fl [args { -d D }]
+	if { [llength $fl] != 1 } {
+		usage
+	}
+
+	if [catch { open [lindex $fl 0] "r" } fd] {
+		err "cannot open [lindex $fl 0], $fd"
+	}
+
+	set tags ""
+	while { [gets $fd ln] >= 0 } {
+		if { [string index $ln 0] == "#" ||
+		     [lindex $ln 0] != "tag" } {
+			continue
+		}
+		lappend tags $ln
+	}
+	close $fd
+
+	if { $tags == "" } {
+		err "no tags in the scenario"
+	}
+
+	puts [format "%-8s %2s %2s %6s %4s %7s %6s %5s %8s %8s %8s %5s %5s" \
+		"Tag" "G" "Ch" "Dist" "Rate" "Blocks" "Lost%" "Dups" "Blk/s" \
+		"Lat ms" "Lat95" "QDrop" "PLoss"]
+
+	foreach t $tags {
+		lassign $t tp hid g ch x y d r
+		set bn [file join $PAR(D) "tag_$hid"]
+		set st [capture "${bn}.raw"]
+		if { $st == "" } {
+			puts [format "%-8s %2s %2s %6.2f %4s   (no capture)" \
+				$hid $g $ch $d $r]
+			continue
+		}
+		lassign $st nb nl nd du ne nq pl lm lp
+		set qd [status_qdrops "${bn}.log"]
+		if { $qd == "-" } {
+			# only the number of trains that reported drops
+			set qd ">$nq"
+			if { $nq == 0 } {
+				set qd 0
+			}
+		}
+		set lr [expr { ($nb + $nl) ? 100.0 * $nl / ($nb + $nl) : 0.0 }]
+		set gp [expr { $du > 0.0 ? $nb / $du : 0.0 }]
+		puts [format "%-8s %2s %2s %6.2f %4s %7u %6.2f %5u %8.2f %8.1f\
+			%8.1f %5s %5u" $hid $g $ch $d $r $nb $lr $nd $gp $lm $lp \
+			$qd $pl]
+		if ![info exists CH($ch,n)] {
+			foreach k { n nb nl nd gp } {
+				set CH($ch,$k) 0
+			}
+			lappend chl $ch
+		}
+		foreach k { nb nl nd gp } {
+			set CH($ch,$k) [expr { $CH($ch,$k) + [set $k] }]
+		}
+		incr CH($ch,n)
+	}
+
+	if ![info exists chl] {
+		return
+	}
+
+	puts ""
+	puts [format "%-8s %5s %7s %6s %5s %8s" "Channel" "Tags" "Blocks" \
+		"Lost%" "Dups" "Blk/s"]
+	set tn 0
+	set tb 0
+	set tl 0
+	set tg 0.0
+	foreach ch [lsort -integer $chl] {
+		set nb $CH($ch,nb)
+		set nl $CH($ch,nl)
+		puts [format "%-8s %5u %7u %6.2f %5u %8.2f" $ch $CH($ch,n) \
+			$nb [expr { ($nb + $nl) ? 100.0 * $nl / ($nb + $nl) : \
+			0.0 }] $CH($ch,nd) $CH($ch,gp)]
+		incr tn $CH($ch,n)
+		incr tb $nb
+		incr tl $nl
+		set tg [expr { $tg + $CH($ch,gp) }]
+	}
+	puts [format "%-8s %5s %7u %6.2f %5s %8.2f" "Total" $tn \
+		$tb [expr { ($tb + $tl) ? 100.0 * $tl / ($tb + $tl) : 0.0 }] "" \
+		$tg]
+}
+
+###############################################################################
+
+proc main { } {
+
+	global argv
+
+	set cmd [lindex $argv 0]
+	set argv [lrange $argv 1 end]
+
+	switch -- $cmd {
+		"generate"	{ generate }
+		"summarize"	{ summarize }
+		default		{ usage }
+	}
+}
+
+main
@@ -0,0 +1,176 @@
+/*
+	Copyright 2002-2021 (C) Olsonet Communications Corporation
+	Programmed by Pawel Gburzynski
+	All rights reserved
+
+	This file is part of the PICOS platform
+
+*/
+
+#include "tag.h"
+#include "sensing.h"
+#include "activity.h"
+#include "energy.h"
+
+//
+// A lightweight (integer) gait classifier running over the accel readings.
+// The magnitude of the acceleration vector is split into its slow component
+// (gravity + posture, tracked by an EMA) and the dynamic remainder. The mean
+// absolute value of the dynamic part over a short window, smoothed across
+// windows, determines the state; steps are counted as upward crossings of
+// the dynamic part through a threshold (with hysteresis at zero). All
+// thresholds are expressed as fractions of 1g, so they don't depend on the
+// range setting.
+//
+
+byte	ActivityState;
+
+static	lword	ADuration [ACTIVITY_NSTATES],	// Msecs per state
+		AWinMs,				// Window duration
+		AMean,				// Magnitude EMA << AEMA
+		ASum;				// Sum of |dynamic| in window
+static	word	AWin, ACount, AOneG, ALevel, ASteps;
+static	Boolean	AArmed;
+
+// The EMA tracking the slow component spans about 2^AEMA samples
+#define	AEMA		7
+
+// Level thresholds separating the states (fractions of 1g)
+#define	lv_rest(g)	((g) >> 5)	// 1/32 g
+#define	lv_walk(g)	((g) >> 3)	// 1/8 g
+#define	lv_trot(g)	((g) >> 1)	// 1/2 g
+// Dynamic acceleration counting as a step
+#define	lv_step(g)	((g) >> 3)	// 1/8 g
+
+static word isqrt (lword v) {
+//
+// Integer square root
+//
+	lword r, b;
+
+	r = 0;
+	b = 1L << 30;
+
+	while (b > v)
+		b >>= 2;
+
+	while (b) {
+		if (v >= r + b) {
+			v -= r + b;
+			r = (r >> 1) + b;
+		} else {
+			r >>= 1;
+		}
+		b >>= 2;
+	}
+
+	return (word) r;
+}
+
+void activity_start (word rate, word range) {
+//
+// Rate in samples per minute, range as in the IMU configuration (0-3 for
+// 2, 4, 8, 16g)
+//
+	if (rate == 0)
+		rate = 1;
+
+	if ((AWin = rate / 240) < ACTIVITY_MIN_WINDOW)
+		AWin = ACTIVITY_MIN_WINDOW;
+
+	AWinMs = ((lword) AWin * 60000) / rate;
+
+	// Sensor units are scaled down by 16 before processing
+	AOneG = (16384 >> (range & 3)) >> 4;
+
+	bzero (ADuration, sizeof (ADuration));
+	AMean = ((lword) AOneG) << AEMA;
+	ASum = 0;
+	ACount = ALevel = ASteps = 0;
+	AArmed = NO;
+	ActivityState = ACTIVITY_REST;
+}
+
+static void activity_feed (const sint *v) {
+
+	sint d;
+	word a, b, c;
+
+	a = (word)(v [0] < 0 ? -v [0] : v [0]) >> 4;
+	b = (word)(v [1] < 0 ? -v [1] : v [1]) >> 4;
+	c = (word)(v [2] < 0 ? -v [2] : v [2]) >> 4;
+
+	// The dynamic component of the magnitude
+	d = (sint) isqrt ((lword) a * a + (lword) b * b + (lword) c * c) -
+		(sint)(AMean >> AEMA);
+
+	AMean += d;
+
+	if (d < 0) {
+		AArmed = YES;
+		ASum += (word)(-d);
+	} else {
+		if (AArmed && d >= (sint) lv_step (AOneG)) {
+			AArmed = NO;
+			ASteps++;
+		}
+		ASum += (word) d;
+	}
+
+	if (++ACount < AWin)
+		return;
+
+	// End of window
+	ALevel = (word)((ALevel * 3 + ASum / AWin) >> 2);
+
+	if (ALevel < lv_rest (AOneG))
+		ActivityState = ACTIVITY_REST;
+	else if (ALevel < lv_walk (AOneG))
+		ActivityState = ACTIVITY_WALK;
+	else if (ALevel < lv_trot (AOneG))
+		ActivityState = ACTIVITY_TROT;
+	else
+		ActivityState = ACTIVITY_RUN;
+
+	ADuration [ActivityState] += AWinMs;
+
+	ACount = 0;
+	ASum = 0;
+}
+
+word activity_report (byte *where) {
+//
+// Store the summary and reset it
+//
+	if (where) {
+		memcpy (where, ADuration, sizeof (ADuration));
+		memcpy (where + sizeof (ADuration), &ASteps, 2);
+		bzero (ADuration, sizeof (ADuration));
+		ASteps = 0;
+	}
+
+	return ACTIVITY_REPORT_SIZE;
+}
+
+fsm activity_sampler {
+
+	state AC_TAKE:
+
+		// Accel only, sensing_configure rejects other components
+		// with the classifier
+		word values [3];
+		sint v [3];
+
+		read_mpu9250 (WNONE, values);
+		energy_awake (EN_US_SAMPLE);
+		// The readings are 16-bit signed, sint is 32 bits on the
+		// CC1350
+		v [0] = (sint)(short) values [0];
+		v [1] = (sint)(short) values [1];
+		v [2] = (sint)(short) values [2];
+		activity_feed (v);
+
+	initial state AC_WAIT:
+
+		ready_mpu9250 (AC_TAKE);
+}
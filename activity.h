@@ -0,0 +1,38 @@
+/*
+	Copyright 2002-2021 (C) Olsonet Communications Corporation
+	Programmed by Pawel Gburzynski
+	All rights reserved
+
+	This file is part of the PICOS platform
+
+*/
+#ifndef	__pg_activity_h
+#define	__pg_activity_h
+
+//+++ activity.cc
+
+#include "sysio.h"
+
+// Activity states
+#define	ACTIVITY_REST		0
+#define	ACTIVITY_WALK		1
+#define	ACTIVITY_TROT		2
+#define	ACTIVITY_RUN		3
+#define	ACTIVITY_NSTATES	4
+
+// The summary returned in a report: the time (msecs) spent in each state,
+// followed by the step count, both since the previous report
+#define	ACTIVITY_REPORT_SIZE	(ACTIVITY_NSTATES * 4 + 2)
+
+// Classification window: about 1/4 sec worth of samples (but no fewer than
+// this)
+#define	ACTIVITY_MIN_WINDOW	4
+
+extern byte ActivityState;
+
+void activity_start (word, word);
+word activity_report (byte*);
+
+fsm activity_sampler;
+
+#endif
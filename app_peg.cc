@@ -33,6 +33,16 @@ word 			loss_count;	// Lost blocks reported by the Peg
 
 static command_ap_t	APS = { 0, 2, 0 };		// AP status
 
+// Channel assignment: the home channel is APS.nodeid & 7
+static byte		ChanCur,	// The current channel
+			ChanNext = BNONE,	// To move to on the Tag's ACK
+			ChanRef,	// ... of this command
+			ChanIdle;	// Seconds without a packet
+static word		ChanDwell, ChanBytes, ChanLoad [CHAN_COUNT];
+static Boolean		ChanAuto;
+
+#define	chan_home()	((byte)(APS.nodeid & 7))
+
 // ============================================================================
 
 static void led_hb () {
@@ -53,11 +63,11 @@ static void led_rx () {
 
 #if ERROR_SIMULATOR
 
-static word		FLoss;
+static word		FLoss, FBLoss, FGBTr, FBGTr;
 
 Boolean byte_error (word pl) {
 
-	return FLoss && (((lword) FLoss * pl) >= rnd ());
+	return ge_error (FLoss, FBLoss, FGBTr, FBGTr, pl);
 }
 
 #endif
@@ -89,6 +99,180 @@ fsm rooster_thread (byte ref) {
 			finish;
 }
 
+fsm beacon_thread {
+//
+// Coordinator: one beacon at the beginning of every TDMA cycle (or sync
+// interval); the Tags time their slots and samples from the reception, so
+// no LBT
+//
+	state BT_SEND:
+
+		address msg;
+
+		if ((msg = pegstream_beacon ()) == NULL) {
+			delay (1, BT_SEND);
+			release;
+		}
+
+		tcv_endpx (msg, NO);
+		delay (pegstream_binterval (), BT_SEND);
+}
+
+static void coord_sid () {
+//
+// The coordinator broadcasts (SID == 0, which also makes it receive all
+// packets on the channel; those are ignored)
+//
+	word sid;
+
+	sid = pegstream_coordinating () ? 0 : APS.nodeid;
+	tcv_control (RFC, PHYSOPT_SETSID, &sid);
+}
+
+static void coord_restart () {
+//
+// After a change of the schedule or the sync interval
+//
+	killall (beacon_thread);
+	if (pegstream_coordinating ())
+		runfsm beacon_thread;
+	coord_sid ();
+}
+
+// ============================================================================
+
+fsm chan_monitor {
+//
+// Off the home channel: go back after CHAN_TIMEOUT seconds of not hearing
+// from the Tag (it does the same)
+//
+	state CM_LOOP:
+
+		delay (1024, CM_CHECK);
+		release;
+
+	state CM_CHECK:
+
+		word c;
+
+		if (ChanCur == chan_home ())
+			finish;
+
+		if (++ChanIdle < CHAN_TIMEOUT)
+			sameas CM_LOOP;
+
+		c = ChanCur = chan_home ();
+		ChanNext = BNONE;
+		tcv_control (RFC, PHYSOPT_SETCHANNEL, &c);
+		finish;
+}
+
+static void chan_set (byte ch) {
+//
+// Move to the channel, the Tag has acknowledged the move
+//
+	word c;
+
+	c = ChanCur = ch;
+	ChanNext = BNONE;
+	ChanIdle = 0;
+	tcv_control (RFC, PHYSOPT_SETCHANNEL, &c);
+	if (ch != chan_home () && !running (chan_monitor))
+		runfsm chan_monitor;
+}
+
+static void chan_order () {
+//
+// Tell the Tag to move to ChanNext (we follow on its ACK)
+//
+	address msg;
+	word i;
+
+	for (i = 0; i < APS.nretr; i++) {
+		if ((msg = osscmn_xpkt (command_chan_code, ChanRef,
+		    sizeof (command_chan_t))) == NULL)
+			return;
+		((command_chan_t*)pkt_payload (msg)) -> dwell = 0;
+		((command_chan_t*)pkt_payload (msg)) -> channel = ChanNext;
+		tcv_endpx (msg, YES);
+	}
+}
+
+fsm chan_survey {
+//
+// Count the bytes received on every channel (SID 0 receives all packets)
+// for ChanDwell msecs, report the load in 1/1000 of airtime; with ChanAuto,
+// move the Tag to the least loaded channel
+//
+	byte Ch;
+
+	state CS_START:
+
+		word sid;
+
+		sid = 0;
+		tcv_control (RFC, PHYSOPT_SETSID, &sid);
+		Ch = 0;
+
+	state CS_TUNE:
+
+		word c;
+
+		c = Ch;
+		tcv_control (RFC, PHYSOPT_SETCHANNEL, &c);
+		ChanBytes = 0;
+		delay (ChanDwell, CS_NEXT);
+		release;
+
+	state CS_NEXT:
+
+		lword l;
+		word c;
+
+		l = ((lword) ChanBytes * 8 * 1000) /
+			((lword)(RF_BITRATE / 1000) * ChanDwell);
+		ChanLoad [Ch] = l > 1000 ? 1000 : (word) l;
+		if (++Ch < CHAN_COUNT)
+			sameas CS_TUNE;
+
+		// Back to the current channel
+		c = ChanCur;
+		tcv_control (RFC, PHYSOPT_SETCHANNEL, &c);
+		coord_sid ();
+
+		if (ChanAuto) {
+			// Stay put unless another channel is less loaded
+			ChanNext = ChanCur;
+			for (Ch = 0; Ch < CHAN_COUNT; Ch++)
+				if (ChanLoad [Ch] < ChanLoad [ChanNext])
+					ChanNext = Ch;
+			chan_order ();
+		}
+
+	state CS_REPORT:
+
+		address msg;
+
+		if ((msg = tcv_wnp (WNONE, sd_uart, upl (sizeof (oss_hdr_t) +
+		    sizeof (message_chan_t)))) == NULL) {
+			delay (1, CS_REPORT);
+			release;
+		}
+
+		((oss_hdr_t*)msg)->code = message_chan_code;
+		((oss_hdr_t*)msg)->ref = ChanRef;
+#define	mmt	((message_chan_t*)(msg + 1))
+		mmt->dwell = ChanDwell;
+		memcpy (mmt->load, ChanLoad, sizeof (ChanLoad));
+		mmt->current = ChanCur;
+		mmt->next = ChanNext;
+		mmt->home = chan_home ();
+#undef	mmt
+		tcv_endp (msg);
+		led_tt ();
+		finish;
+}
+
 // ============================================================================
 
 static void oss_ack (word status) {
@@ -146,10 +330,11 @@ static void handle_oss_command () {
 		if (pmt->nodeid != WNONE) {
 			if (pmt->nodeid != 0) {
 				// Request to set group Id
-				i = (APS.nodeid = pmt->nodeid) & 7;
-				tcv_control (RFC, PHYSOPT_SETSID,
-					&(APS.nodeid));
-				tcv_control (RFC, PHYSOPT_SETCHANNEL, &i);
+				APS.nodeid = pmt->nodeid;
+				// Home, the Tag will follow on timeout
+				killall (chan_survey);
+				chan_set (chan_home ());
+				coord_sid ();
 			}
 			done++;
 		}
@@ -170,6 +355,18 @@ static void handle_oss_command () {
 			FLoss = pmt->loss;
 			done++;
 		}
+		if (pmt->bloss != WNONE) {
+			FBLoss = pmt->bloss;
+			done++;
+		}
+		if (pmt->gbtr != WNONE) {
+			FGBTr = pmt->gbtr;
+			done++;
+		}
+		if (pmt->bgtr != WNONE) {
+			FBGTr = pmt->bgtr;
+			done++;
+		}
 #endif
 
 		if (done) {
@@ -187,6 +384,9 @@ static void handle_oss_command () {
 			memcpy (msg + 1, &APS, sizeof (message_ap_t));
 #if ERROR_SIMULATOR
 			((message_ap_t*)(msg + 1)) -> loss = FLoss;
+			((message_ap_t*)(msg + 1)) -> bloss = FBLoss;
+			((message_ap_t*)(msg + 1)) -> gbtr = FGBTr;
+			((message_ap_t*)(msg + 1)) -> bgtr = FBGTr;
 #endif
 			tcv_endp (msg);
 		}
@@ -195,6 +395,142 @@ static void handle_oss_command () {
 #undef	pmt
 	}
 
+	if (CMD->code == command_tdma_code) {
+		// TDMA schedule, also addressed to the AP
+		if (PML < sizeof (command_tdma_t)) {
+			oss_ack (ACK_AP_FMT);
+			return;
+		}
+		if (CMD->ref == LastRef)
+			return;
+
+#define	pmt	((command_tdma_t*)PMT)
+		if (pmt->cycle != WNONE) {
+			if (PML < sizeof (command_tdma_t) + pmt->groups.size) {
+				oss_ack (ACK_AP_FMT);
+				return;
+			}
+			if ((i = pegstream_tdma (pmt->cycle,
+			    pmt->groups.content, pmt->groups.size)) == ACK_OK)
+				coord_restart ();
+			oss_ack (i);
+			LastRef = CMD->ref;
+		} else {
+			// Report the schedule
+			i = ScheduleSlots * sizeof (word);
+			if ((msg = tcv_wnp (WNONE, sd_uart,
+			    upl (sizeof (oss_hdr_t) + sizeof (message_tdma_t) +
+			    i))) == NULL)
+				return;
+			LastRef = CMD->ref;
+			msghdr->code = message_tdma_code;
+			msghdr->ref = CMD->ref;
+#define	mmt	((message_tdma_t*)(msg + 1))
+			mmt->cycle = ScheduleSlots ? Schedule . cycle : 0;
+			mmt->slot = Schedule . slot;
+			mmt->groups.size = i;
+			memcpy (mmt->groups.content, Schedule . groups, i);
+#undef	mmt
+			tcv_endp (msg);
+		}
+		led_tt ();
+		return;
+#undef	pmt
+	}
+
+	if (CMD->code == command_sync_code) {
+		// Sync beacons, also addressed to the AP
+		if (PML < sizeof (command_sync_t)) {
+			oss_ack (ACK_AP_FMT);
+			return;
+		}
+		if (CMD->ref == LastRef)
+			return;
+
+#define	pmt	((command_sync_t*)PMT)
+		if (pmt->interval != WNONE) {
+			if ((i = pegstream_sync (pmt->interval)) == ACK_OK)
+				coord_restart ();
+			oss_ack (i);
+			LastRef = CMD->ref;
+		} else {
+			// Report the interval and the clock
+			if ((msg = tcv_wnp (WNONE, sd_uart,
+			    upl (sizeof (oss_hdr_t) + sizeof (message_sync_t))))
+			    == NULL)
+				return;
+			LastRef = CMD->ref;
+			msghdr->code = message_sync_code;
+			msghdr->ref = CMD->ref;
+#define	mmt	((message_sync_t*)(msg + 1))
+			mmt->clock = strm_ticks ();
+			mmt->interval = pegstream_coordinating () ?
+				pegstream_binterval () : 0;
+#undef	mmt
+			tcv_endp (msg);
+		}
+		led_tt ();
+		return;
+#undef	pmt
+	}
+
+	if (CMD->code == command_chan_code) {
+		// Channel assignment, the survey is done by the AP, the move
+		// is passed to the Tag
+		if (PML < sizeof (command_chan_t)) {
+			oss_ack (ACK_AP_FMT);
+			return;
+		}
+
+#define	pmt	((command_chan_t*)PMT)
+		if (pmt->channel >= CHAN_COUNT) {
+			if (CMD->ref == LastRef) {
+				if (ChanNext != BNONE && CMD->ref == ChanRef &&
+				    !running (chan_survey))
+					// The Tag's ACK hasn't made it, repeat
+					chan_order ();
+				return;
+			}
+			if (pegstream_coordinating () ||
+			    running (chan_survey)) {
+				oss_ack (ACK_BUSY);
+				return;
+			}
+			if (pmt->channel != CHAN_AUTO &&
+			    pmt->channel != BNONE) {
+				oss_ack (ACK_PARAM);
+				return;
+			}
+			if ((i = pmt->dwell) == 0)
+				i = CHAN_DWELL;
+			else if (i < CHAN_DWELL_MIN || i > CHAN_DWELL_MAX) {
+				oss_ack (ACK_PARAM);
+				return;
+			}
+			ChanDwell = i;
+			ChanAuto = (pmt->channel == CHAN_AUTO);
+			ChanNext = BNONE;
+			ChanRef = LastRef = CMD->ref;
+			runfsm chan_survey;
+			return;
+		}
+#undef	pmt
+	}
+
+	if (pegstream_coordinating () || running (chan_survey)) {
+		// The coordinator doesn't talk to Tags, its packets would
+		// reach all of them; nor does a Peg away on a survey
+		oss_ack (ACK_BUSY);
+		return;
+	}
+
+	if (CMD->code == command_chan_code) {
+		// Move to the given channel: pass it to the Tag, follow on its
+		// ACK
+		ChanNext = ((command_chan_t*)PMT)->channel;
+		ChanRef = CMD->ref;
+	}
+
 	if (PML > MAX_PACKET_LENGTH - PKT_FRAME_ALL) {
 		// Too long for radio
 		oss_ack (ACK_AP_TOOLONG);
@@ -216,6 +552,12 @@ static void handle_oss_command () {
 		// Intercept this one before sending it out
 		pegstream_init ();
 
+	if (CMD->code == command_stop_code && ChanCur != chan_home ()) {
+		// The end of session, the Tag goes home after the ACK
+		ChanNext = chan_home ();
+		ChanRef = CMD->ref;
+	}
+
 	i = 0;
 	led_tt ();
 
@@ -237,11 +579,29 @@ void handle_rf_packet (byte code, byte ref, address pkt, word mpl) {
 //
 	address msg;
 
-	if (ENABLE_RF_HALT && APS.halt)
+	if (running (chan_survey)) {
+		// Only count the bytes on the channel
+		ChanBytes += mpl + PKT_FRAME_ALL + RF_FRAME_OVERHEAD;
+		return;
+	}
+
+	if ((ENABLE_RF_HALT && APS.halt) || pegstream_coordinating () ||
+	    code == MESSAGE_CODE_BEACON)
+		// Nothing for the coordinator; beacons (of another Peg) are
+		// for the Tags
 		return;
 
 	led_rx ();
-	if (code == MESSAGE_CODE_SBLOCK) {
+	ChanIdle = 0;
+	if (code == 0 && ref == ChanRef && ChanNext != BNONE &&
+	    mpl >= sizeof (word)) {
+		// The Tag has acknowledged the move (or the stop), follow it
+		if (pkt [0] == ACK_OK || pkt [0] == ACK_VOID)
+			chan_set (ChanNext);
+		else
+			ChanNext = BNONE;
+	} else if (code == MESSAGE_CODE_SBLOCK ||
+	    code == MESSAGE_CODE_MBLOCK) {
 		if (mpl < STRM_NCODES * 4)
 			// Ignore garbage
 			return;
@@ -253,7 +613,7 @@ void handle_rf_packet (byte code, byte ref, address pkt, word mpl) {
 
 		pegstream_eot (ref, pkt);
 		// Piggyback the loss_count onto upper nibble; the Tag only
-		// uses three lower flags
+		// uses the lower nibble
 		if (loss_count) {
 			((message_etrain_t*) pkt) -> flags |= 
 				((loss_count > 15) ? 0xf0 :
@@ -280,11 +640,11 @@ fsm root {
 
 		word si;
 
-		si = (APS.nodeid = GROUP_ID) & 7;
+		si = ChanCur = (APS.nodeid = GROUP_ID) & 7;
 
 		led_signal (0, 4, 128);
 
-		phys_uart (1, OSS_PACKET_LENGTH, 0);
+		phys_uart (1, UART_PACKET_LENGTH, 0);
 
 		osscmn_init ();
 		// Set channel to match the assumed (initial) node Id
@@ -12,6 +12,7 @@
 #include "sensing.h"
 #include "streaming.h"
 #include "sampling.h"
+#include "energy.h"
 #include "ledsignal.h"
 
 // ============================================================================
@@ -24,6 +25,11 @@ word	Voltage;
 
 static	byte  MonStat, MonWake, MonRef, BatCnt = 1;
 
+// Channel assignment (by the Peg, for a session)
+static	byte  ChanCur, ChanNext, ChanIdle;
+
+#define	chan_home()	((byte)(GROUP_ID & 7))
+
 #define	MS_ON		0
 #define	MS_OFF		1
 
@@ -34,7 +40,7 @@ tag_params_t	TagParams = {
 				STRM_MAX_QUEUED,
 				STRM_CAR_SPACE,
 				STRM_MIN_TRAIN_SPACE,
-				0,
+				0, 0, 0, 0
 			};
 
 stream_stats_t	StreamStats;
@@ -43,14 +49,78 @@ stream_stats_t	StreamStats;
 
 Boolean byte_error (word pl) {
 
-	return TagParams.byte_error_rate &&
-		(((lword) (TagParams.byte_error_rate) * pl) >= rnd ());
+	return ge_error (TagParams.byte_error_rate, TagParams.byte_error_bad,
+		TagParams.gb_transition, TagParams.bg_transition, pl);
 }
 
 #endif
 
 // ============================================================================
 
+fsm chan_thread {
+//
+// Switch to ChanNext after the ACK has gone out; off the home channel, go
+// back after CHAN_TIMEOUT seconds of not hearing from the Peg (it does the
+// same)
+//
+	state CT_START:
+
+		delay (CHAN_SWITCH_DELAY, CT_SET);
+		release;
+
+	state CT_SET:
+
+		word c;
+
+		c = ChanCur = ChanNext;
+		tcv_control (RFC, PHYSOPT_SETCHANNEL, &c);
+		ChanIdle = 0;
+
+	state CT_LOOP:
+
+		if (ChanCur == chan_home ())
+			finish;
+
+		delay (1024, CT_CHECK);
+		release;
+
+	state CT_CHECK:
+
+		if (++ChanIdle < CHAN_TIMEOUT)
+			sameas CT_LOOP;
+
+		ChanNext = chan_home ();
+		sameas CT_SET;
+}
+
+static word chan_move (byte ch) {
+//
+// Move to the channel (the Peg follows on our ACK)
+//
+	if (ch >= CHAN_COUNT)
+		return ACK_PARAM;
+
+	killall (chan_thread);
+	ChanNext = ch;
+	runfsm chan_thread;
+	return ACK_OK;
+}
+
+static void chan_reset () {
+//
+// Back home right away (the radio is going off)
+//
+	word c;
+
+	killall (chan_thread);
+	if (ChanCur != chan_home ()) {
+		c = ChanCur = chan_home ();
+		tcv_control (RFC, PHYSOPT_SETCHANNEL, &c);
+	}
+}
+
+// ============================================================================
+
 fsm rf_monitor {
 
 	state RFM_ON:
@@ -68,7 +138,9 @@ fsm rf_monitor {
 			sampling_stop ();
 			streaming_stop ();
 			sensing_all_off ();
+			chan_reset ();
 			tcv_control (RFC, PHYSOPT_OFF, NULL);
+			energy_radio (NO);
 			sameas RFM_OFF;
 		}
 
@@ -80,6 +152,8 @@ fsm rf_monitor {
 	state RFM_BATTMON:
 
 		read_sensor (RFM_BATTMON, SENSOR_BATTERY, &Voltage);
+		// Often enough for the RTC not to wrap between updates
+		energy_update ();
 		BatCnt = ACT_BATTMON_FREQ;
 		sameas RFM_ON;
 
@@ -94,6 +168,7 @@ fsm rf_monitor {
 	state RFM_RUN_OFF:
 
 		tcv_control (RFC, PHYSOPT_ON, NULL);
+		energy_radio (YES);
 		delay (ACT_RXON_INTERVAL, RFM_CHECK_WAKE);
 		release;
 
@@ -111,6 +186,7 @@ fsm rf_monitor {
 
 		// No activity
 		tcv_control (RFC, PHYSOPT_OFF, NULL);
+		energy_radio (NO);
 		sameas RFM_OFF;
 
 	state RFM_WACK:
@@ -153,6 +229,7 @@ fsm delayed_switch {
 	state DS_SWITCH:
 
 		tcv_control (RFC, PHYSOPT_OFF, NULL);
+		energy_radio (NO);
 		sensing_all_off ();
 		delay (1024, DS_HIBERNATE);
 		release;
@@ -260,6 +337,10 @@ void handle_rf_packet (byte code, byte ref, const address par, word pml) {
 	word ret;
 	address msg;
 
+	if (code != MESSAGE_CODE_BEACON)
+		// The Peg is there (beacons come from the coordinator)
+		ChanIdle = 0;
+
 	if (code == MESSAGE_CODE_STRACK) {
 		// Ignore ref
 		streaming_tack (ref, (byte*) par, pml);
@@ -267,6 +348,12 @@ void handle_rf_packet (byte code, byte ref, const address par, word pml) {
 
 	}
 
+	if (code == MESSAGE_CODE_BEACON) {
+		// TDMA schedule
+		streaming_beacon (ref, par, pml);
+		return;
+	}
+
 	if (code == command_wake_code) {
 		// Ignore ref
 		handle_wake (ref);
@@ -353,8 +440,32 @@ void handle_rf_packet (byte code, byte ref, const address par, word pml) {
 				streaming_stop ();
 			} else
 				ret = ACK_VOID;
+			// The end of session, go home after the ACK
+			if (ChanCur != chan_home () || running (chan_thread))
+				chan_move (chan_home ());
 			break;
 
+		case command_chan_code:
+
+			if (pml < sizeof (command_chan_t))
+				ret = ACK_LENGTH;
+			else
+				ret = chan_move (
+				    ((const command_chan_t*) par)->channel);
+			break;
+
+#if STREAM_PROFILE
+		case command_profile_code:
+
+			if (pml < 1) {
+				ret = ACK_LENGTH;
+				break;
+			}
+			if ((ret = streaming_send_profile (*((byte*)par))) ==
+			    ACK_OK)
+				return;
+			break;
+#endif
 		case command_mreg_code:
 
 			do_mreg ((const command_mreg_t*) par, pml);
@@ -450,10 +561,11 @@ fsm root {
 		led_signal (0, 1, 128);
 		// Initialize the interface in RF active state
 		osscmn_init ();
+		energy_radio (YES);
 
-		// Channel number determined from node Id
-		cn = GROUP_ID & 7;
-		// This never changes for a Tag
+		// Home channel determined from node Id; the Peg can move us
+		// for a session (chan_move)
+		cn = ChanCur = chan_home ();
 		tcv_control (RFC, PHYSOPT_SETCHANNEL, &cn);
 
 		runfsm rf_monitor;
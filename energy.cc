@@ -0,0 +1,162 @@
+/*
+	Copyright 2002-2021 (C) Olsonet Communications Corporation
+	Programmed by Pawel Gburzynski
+	All rights reserved
+
+	This file is part of the PICOS platform
+
+*/
+#include "tag.h"
+#include "sensing.h"
+#include "energy.h"
+
+//
+// The times are in RTC ticks (1/65536 s); the charges are accumulated in uC
+// with the fractions kept separately, so nothing is lost on short intervals
+//
+
+#ifdef	__SMURPH__
+#define	en_clock()	(seconds () << 16)
+#else
+#include <driverlib/aon_rtc.h>
+#define	en_clock()	AONRTCCurrentCompareValueGet ()
+#endif
+
+static const word SensorUA [] = {
+	// In the order of sensor indexes
+	EN_UA_MPU9250,
+	EN_UA_OBMICROPHONE,
+	EN_UA_BMP280,
+	EN_UA_HDC1000,
+	EN_UA_OPT3001,
+};
+
+static lword	Charge [EN_NCOMPS], Frac [EN_NCOMPS], Last, TxPending;
+static lword	AwakeRem;
+static Boolean	RadioOn, Powered;
+
+static void charge (sint c, word ua, lword t) {
+
+	lword f;
+
+	Charge [c] += (lword) ua * (t >> 16);
+	f = (lword) ua * (t & 0xffff) + Frac [c];
+	Charge [c] += f >> 16;
+	Frac [c] = f & 0xffff;
+}
+
+void energy_update () {
+//
+// Charge the time since the last update at the present states; to be
+// called before every state change (and often enough for the RTC not to
+// wrap, i.e., once in 18 hours)
+//
+	lword t, d;
+	word ua;
+	sint i;
+
+	t = en_clock ();
+	d = t - Last;
+	Last = t;
+
+	if (RadioOn) {
+		// The transmission time has been charged already
+		if (TxPending >= d) {
+			TxPending -= d;
+		} else {
+			charge (EN_RX, EN_UA_RX, d - TxPending);
+			TxPending = 0;
+		}
+	}
+
+	// The idle current; the wakeups are charged by energy_awake
+	charge (EN_CPU, Powered ? EN_UA_IDLE : EN_UA_SLEEP, d);
+
+	for (ua = 0, i = 0; i < sizeof (SensorUA) / sizeof (word); i++)
+		if (Sensors & (1 << i))
+			ua += SensorUA [i];
+	if (ua)
+		charge (EN_SENSORS, ua, d);
+}
+
+void energy_radio (Boolean on) {
+
+	energy_update ();
+	RadioOn = on;
+}
+
+void energy_powerup (Boolean on) {
+//
+// The CPU's power mode (powerup/powerdown) determines its idle current
+//
+	energy_update ();
+	Powered = on;
+}
+
+void energy_awake (word us) {
+//
+// A wakeup has done us microseconds worth of work; the time is charged at
+// the awake current above the idle one (which update has charged already)
+//
+	lword t;
+
+	t = us;
+	if (!Powered)
+		t += EN_US_STANDBY;
+
+	// In RTC ticks, the remainder carried over to the next wakeup
+	t = (t << 16) + AwakeRem;
+	AwakeRem = t % 1000000;
+
+	charge (EN_CPU, EN_UA_AWAKE - (Powered ? EN_UA_IDLE : EN_UA_SLEEP),
+		t / 1000000);
+}
+
+void energy_tx (word len) {
+//
+// A packet of len bytes (payload + header) has been queued for
+// transmission; it preempts the reception
+//
+	lword t;
+
+	t = ((lword)(len + EN_FRAME_OVERHEAD) * 8 * 65536) / EN_BITRATE;
+	charge (EN_TX, EN_UA_TX, t);
+	if (RadioOn)
+		TxPending += t;
+}
+
+void energy_start () {
+//
+// Start a session
+//
+	energy_update ();
+	bzero (Charge, sizeof (Charge));
+	bzero (Frac, sizeof (Frac));
+	TxPending = AwakeRem = 0;
+}
+
+lword energy_total (byte *share) {
+//
+// Returns the energy since the session start in uJ, fills the shares of the
+// components (percent)
+//
+	lword c, mv;
+	sint i;
+
+	energy_update ();
+
+	for (c = 0, i = 0; i < EN_NCOMPS; i++)
+		c += Charge [i];
+
+	for (i = 0; i < EN_NCOMPS; i++)
+		share [i] = c ? (byte)((Charge [i] * 100 + c / 2) / c) : 0;
+
+	// The battery voltage in mV (as in sensor_to_voltage)
+	if ((mv = VOLTAGE) == 0)
+		// Not read yet
+		mv = 3000;
+	else
+		mv = ((mv >> 5) & 0x7) * 1000 + ((mv & 0x1f) * 1000) / 32;
+
+	return (c / 1000) * mv + ((c % 1000) * mv) / 1000;
+}
@@ -0,0 +1,69 @@
+/*
+	Copyright 2002-2021 (C) Olsonet Communications Corporation
+	Programmed by Pawel Gburzynski
+	All rights reserved
+
+	This file is part of the PICOS platform
+
+*/
+#ifndef	__pg_energy_h
+#define	__pg_energy_h
+
+//+++ energy.cc
+
+// Used by the Tag only
+
+#include "sysio.h"
+#include "rf.h"
+
+//
+// Energy accounting: the time spent by the radio (transmitting, receiving),
+// the CPU, and the sensors in their on states is charged at the currents of
+// the board model below; the charge times the battery voltage is the energy
+// reported (per session) in the status message. Between wakeups, the CPU is
+// charged at the idle current of its power mode (standby after powerdown,
+// idle with the clocks running after powerup, as while streaming); every
+// wakeup that does work (a sample, a report, a car) is charged at the awake
+// current for the modelled time of that work (plus the exit from standby
+// in powerdown mode)
+//
+
+// The board model (CC1350 SensorTag), currents in uA
+#define	EN_UA_TX		13400	// +10dBm
+#define	EN_UA_RX		5400
+#define	EN_UA_AWAKE		2900	// CPU running at 48MHz
+#define	EN_UA_IDLE		570	// CPU off, clocks and RAM on
+#define	EN_UA_SLEEP		1	// Standby with RTC
+#define	EN_UA_MPU9250		450	// Accel, normal mode
+#define	EN_UA_OBMICROPHONE	700
+#define	EN_UA_BMP280		3
+#define	EN_UA_HDC1000		1
+#define	EN_UA_OPT3001		2
+
+// The CPU time per wakeup, in usec
+#define	EN_US_STANDBY		150	// Exit from standby and back
+#define	EN_US_SAMPLE		60	// Read and encode a sample
+#define	EN_US_FIFO		40	// Per sample extracted from the FIFO
+#define	EN_US_REPORT		400	// Build and queue a sampling report
+#define	EN_US_PACKET		150	// Build and queue a car or an EOT
+
+// Bit rate and the per-packet overhead, for the transmission time
+#define	EN_BITRATE		RF_BITRATE
+#define	EN_FRAME_OVERHEAD	RF_FRAME_OVERHEAD
+
+// Components (accumulated charges)
+#define	EN_TX			0
+#define	EN_RX			1
+#define	EN_CPU			2
+#define	EN_SENSORS		3
+#define	EN_NCOMPS		4
+
+void energy_start ();
+void energy_update ();
+void energy_radio (Boolean);
+void energy_powerup (Boolean);
+void energy_awake (word);
+void energy_tx (word);
+lword energy_total (byte*);
+
+#endif
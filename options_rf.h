@@ -7,4 +7,11 @@
 #define	RADIO_DEFAULT_CHANNEL		0
 #define	RADIO_DEFAULT_POWER		7
 
+// Streaming cars of up to STRM_MAX_NCODES = 50 codes (stream -size); this
+// makes every radio packet buffer 208 bytes; with 0, the cars are fixed at
+// 12 codes (64-byte packets). ossi.tcl reads this setting (for its packet
+// length and the range of -size), so ossi.h must be regenerated after a
+// change
+#define	STREAM_BIG_CARS			0
+
 #endif
@@ -23,11 +23,16 @@ fsm radio_receiver {
 		mpl = tcv_left (pkt) - PKT_FRAME_ALL;
 
 		if (!byte_error (mpl)) {
-			mark_active;
 			if (tcv_left (pkt) >= PKT_FRAME_ALL) {
 				osh = pkt_osshdr (pkt);
-				handle_rf_packet (osh->code, osh->ref, 
+				// TDMA beacons are not activity, they would keep
+				// idle Tags awake
+				if (osh->code != MESSAGE_CODE_BEACON)
+					mark_active;
+				handle_rf_packet (osh->code, osh->ref,
 					pkt_payload (pkt), mpl);
+			} else {
+				mark_active;
 			}
 		}
 
@@ -35,6 +40,32 @@ fsm radio_receiver {
 		sameas RS_LOOP;
 }
 
+#if ERROR_SIMULATOR
+
+static Boolean	GEBad;
+
+Boolean ge_error (word good, word bad, word gb, word bg, word pl) {
+//
+// Gilbert-Elliott channel: the byte loss rate is good or bad depending on
+// the state, which changes (at most once per packet) with probabilities
+// gb (good -> bad) and bg (bad -> good) times 2^-16; with gb == 0, this is
+// the uniform model
+//
+	if (GEBad) {
+		if (bg && bg >= rnd ())
+			GEBad = NO;
+	} else if (gb && gb >= rnd ()) {
+		GEBad = YES;
+	}
+
+	if (GEBad)
+		good = bad;
+
+	return good && (((lword) good * pl) >= rnd ());
+}
+
+#endif
+
 address osscmn_xpkt (byte code, byte ref, word len) {
 //
 // Tries to acquire a packet for outgoing RF message
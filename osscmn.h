@@ -16,6 +16,17 @@
 #include "tcvphys.h"
 #include "plug_null.h"
 
+// RTC ticks (1/65536 s) for the profile, the TDMA slots, and the time sync
+// (the host harness provides its own)
+#ifndef	strm_ticks
+#ifdef	__SMURPH__
+#define	strm_ticks()	(seconds () << 16)
+#else
+#include <driverlib/aon_rtc.h>
+#define	strm_ticks()	AONRTCCurrentCompareValueGet ()
+#endif
+#endif
+
 // ============================================================================
 
 #define	ACT_MONITOR_INTERVAL	2048
@@ -28,6 +39,19 @@
 #define	ACT_WAKE_SPACE		3		// Millisecs
 #define	ACT_BATTMON_FREQ	255		// x 2 = 512 sec
 
+// Channel assignment: the home channel is GROUP_ID & 7; a Peg surveys the
+// occupancy of all channels (the chan command) and moves itself and its Tag
+// to the least loaded one for the session; both return home on stop, or
+// after CHAN_TIMEOUT seconds of not hearing from each other
+#define	CHAN_COUNT		8
+#define	CHAN_AUTO		CHAN_COUNT	// chan: survey and move
+// Survey time per channel (msecs); 8 x the max must be below the timeout
+#define	CHAN_DWELL		256
+#define	CHAN_DWELL_MIN		32
+#define	CHAN_DWELL_MAX		1024
+#define	CHAN_TIMEOUT		10		// Seconds
+#define	CHAN_SWITCH_DELAY	32		// Tag: for its ACK to go out
+
 // ============================================================================
 
 // Special message codes >= 128
@@ -35,13 +59,25 @@
 #define	MESSAGE_CODE_STRACK		128 	// Train ACK (app -> tag)
 // This one is known to the OSS
 #define MESSAGE_CODE_ETRAIN		message_etrain_code
+#define MESSAGE_CODE_MBLOCK		message_mblock_code	// Mic levels
+#define	MESSAGE_CODE_BEACON		131	// TDMA/sync beacon (app -> tags)
 
-// 12 x 4 = 48 bytes; this is the payload size of a streaming packet
+// 12 x 4 = 48 bytes; this is the default (and minimum) payload size of a
+// streaming packet; the block number is spread over the first STRM_NCODES
+// codes of every car
 #define	STRM_NCODES		12
+// The car size (codes per car) is set by the stream command up to this;
+// STRM_MAX_NCODES x 4 + PKT_FRAME_ALL must fit MAX_PACKET_LENGTH
+#if STREAM_BIG_CARS
+#define	STRM_MAX_NCODES		50
+#else
+#define	STRM_MAX_NCODES		STRM_NCODES
+#endif
 // Maximum number of packets in a train (roughly, one packet = 64 bytes, 156
 // blocks per 10 K), make it 128
 #define	STRM_TRAIN_LENGTH	64
-// Maximum number of stored packets
+// Maximum number of stored packets (of STRM_NCODES codes, larger cars count
+// proportionally more)
 #define	STRM_MAX_QUEUED		128
 // Maximum block offset; this must be derived from the bitmap size for the Peg
 // which must be a power of two
@@ -79,6 +115,39 @@
 #define	STRM_TFLAG_FOV		1	// FIFO overflow
 #define	STRM_TFLAG_MAL		2	// Malloc failure
 #define	STRM_TFLAG_QDR		4	// Queue drop
+#define	STRM_TFLAG_SYN		8	// Sync fields valid
+
+// TDMA schedule for Tags (groups) streaming on the same channel: a Peg
+// set up as the coordinator (the tdma command) broadcasts a beacon at the
+// beginning of every cycle; the slots (of equal length) follow the guard
+// in the order of the groups listed in the beacon
+#define	STRM_TDMA_MAX_SLOTS	8
+#define	STRM_TDMA_GUARD		8	// After the beacon, msecs
+// The end of a slot free of cars (the longest car, the EOT and the ACK) and
+// the end free of EOTs
+#define	STRM_TDMA_TAIL		64
+#define	STRM_TDMA_ETAIL		24
+// Cycles without a beacon after which a Tag stops using its slot
+#define	STRM_TDMA_LOST		4
+
+// Time sync: every beacon carries the coordinator's clock; a Peg set up with
+// the sync command (and no schedule) sends beacons with no slots at this
+// interval (msecs); the Tag maps its samples to the clock of the last beacon
+// received within STRM_SYNC_AGE seconds and reports the mapping in its EOTs
+#define	STRM_SYNC_MIN		64
+#define	STRM_SYNC_MAX		8192
+#define	STRM_SYNC_AGE		16
+
+typedef	struct {
+//
+// The beacon payload (only the listed groups are sent, cycle == 0 means
+// no schedule, i.e., sync only)
+//
+	lword		clock;		// The coordinator's RTC ticks
+	word		cycle;		// msecs
+	word		slot;		// msecs
+	word		groups [STRM_TDMA_MAX_SLOTS];
+} strbcn_t;
 
 typedef	struct strblk_t strblk_t;
 
@@ -88,9 +157,17 @@ struct strblk_t {
 //
 	strblk_t	*next;		// We link them
 	lword 		bn;		// Block number
-	lword		block [STRM_NCODES];
+	byte		code;		// Car type (message code)
+#if STREAM_PROFILE
+	byte		sent;		// Transmissions
+#endif
+	lword		block [STRM_MAX_NCODES];
 };
 
+// Allocated size of a block of n codes
+#define	strblk_size(n)	(sizeof (strblk_t) - \
+				(STRM_MAX_NCODES - (n)) * sizeof (lword))
+
 // ============================================================================
 
 extern byte	LastRef;
@@ -107,6 +184,7 @@ void handle_rf_packet (byte, byte, const address, word);
 
 #if ERROR_SIMULATOR
 Boolean	byte_error (word);
+Boolean	ge_error (word, word, word, word, word);
 #else
 #define	byte_error(a)	NO
 #endif
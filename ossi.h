@@ -5,7 +5,7 @@
 // Generated automatically, do not edit (unless you really want to)!
 // =================================================================
 
-#define	OSS_PRAXIS_ID		65570
+#define	OSS_PRAXIS_ID		65571
 #define	OSS_UART_RATE		230400
 #define	OSS_PACKET_LENGTH	56
 
@@ -54,6 +54,7 @@ typedef struct {
 
 #define	command_stream_code	6
 typedef struct {
+	byte	ncodes;
 	blob	confdata;
 } command_stream_t;
 
@@ -68,6 +69,9 @@ typedef struct {
 	byte	nretr;
 	byte	halt;
 	word	loss;
+	word	bloss;
+	word	gbtr;
+	word	bgtr;
 } command_ap_t;
 
 #define	command_mreg_code	9
@@ -77,6 +81,28 @@ typedef struct {
 	byte	value;
 } command_mreg_t;
 
+#define	command_profile_code	11
+typedef struct {
+	byte	reset;
+} command_profile_t;
+
+#define	command_tdma_code	12
+typedef struct {
+	word	cycle;
+	blob	groups;
+} command_tdma_t;
+
+#define	command_sync_code	13
+typedef struct {
+	word	interval;
+} command_sync_t;
+
+#define	command_chan_code	14
+typedef struct {
+	word	dwell;
+	byte	channel;
+} command_chan_t;
+
 // ==================
 // Message structures
 // ==================
@@ -96,12 +122,20 @@ typedef struct {
 	lword	data [12];
 } message_sblock_t;
 
+#define	message_mblock_code	130
+typedef struct {
+	lword	data [12];
+} message_mblock_t;
+
 #define	message_etrain_code	129
 typedef struct {
 	lword	last;
 	word	offset;
 	byte	voltage;
 	byte	flags;
+	lword	sblock;
+	lword	sclock;
+	word	sfrac;
 } message_etrain_t;
 
 #define	message_status_code	3
@@ -115,9 +149,14 @@ typedef struct {
 	word	freemem;
 	word	minmem;
 	word	rate;
+	word	rerr;
+	word	fhwm;
 	byte	battery;
 	byte	sset;
 	byte	status;
+	byte	eshare [3];
+	lword	energy;
+	lword	epsmp;
 } message_status_t;
 
 #define	message_report_code	5
@@ -138,6 +177,9 @@ typedef struct {
 	word	nodeid;
 	byte	nretr;
 	word	loss;
+	word	bloss;
+	word	gbtr;
+	word	bgtr;
 } message_ap_t;
 
 #define	message_mreg_code	9
@@ -145,6 +187,47 @@ typedef struct {
 	blob	data;
 } message_mreg_t;
 
+#define	message_profile_code	11
+typedef struct {
+	lword	blocks;
+	lword	cars;
+	lword	eots;
+	lword	acks;
+	word	gmean;
+	word	gmax;
+	word	jmean;
+	word	jmax;
+	word	rmean;
+	word	rmax;
+	word	tmax;
+	word	emax;
+	byte	qhist [4];
+	byte	thist [4];
+	byte	rhist [4];
+} message_profile_t;
+
+#define	message_tdma_code	12
+typedef struct {
+	word	cycle;
+	word	slot;
+	blob	groups;
+} message_tdma_t;
+
+#define	message_sync_code	13
+typedef struct {
+	lword	clock;
+	word	interval;
+} message_sync_t;
+
+#define	message_chan_code	14
+typedef struct {
+	word	dwell;
+	word	load [8];
+	byte	current;
+	byte	next;
+	byte	home;
+} message_chan_t;
+
 
 // ===================================
 // End of automatically generated code 
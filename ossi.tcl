@@ -20,7 +20,7 @@ set SNAMES(A)		"imphl"
 variable CPARAMS
 #
 set CPARAMS(imu)	{
-			  { "options" 		"lsmr"	 	}
+			  { "options" 		"lsmrc"	 	}
 			  { "threshold"		"0-255"		}
 			  { "lprate"		"0-11"		}
 			  { "range"		"0-3"		}
@@ -38,6 +38,7 @@ set CPARAMS(humidity)	{
 
 set CPARAMS(microphone)	{
 			  { "rate"		"100-2475"	}
+			  { "stream"		"0-8192"	}
 			}
 
 set CPARAMS(light)	{
@@ -98,12 +99,61 @@ set ACKCODE(131)	"command too long"
 
 variable RAW		0
 
+proc ossdec_load { } {
+#
+# Load the compiled decoder (INTERFACE/ossdec.cc), if available; returns 1
+# on success, 0 means we decode in Tcl
+#
+	set dir [file dirname [info script]]
+	set lib "libossdec[info sharedlibextension]"
+
+	foreach f [list [file join $dir $lib] [file join $dir INTERFACE $lib]] {
+		if { [file exists $f] && ![catch { load $f Ossdec }] } {
+			return 1
+		}
+	}
+
+	return 0
+}
+
+variable OSSDEC		[ossdec_load]
+
+proc big_cars { } {
+#
+# The STREAM_BIG_CARS setting of the praxis (in options_rf.h next to this
+# script); it determines the packet length and the range of stream -size
+#
+	set f [file join [file dirname [info script]] options_rf.h]
+
+	if [catch { open $f "r" } fd] {
+		return 0
+	}
+
+	set s [read $fd]
+	close $fd
+
+	if { [regexp -line \
+	    {^#define[[:space:]]+STREAM_BIG_CARS[[:space:]]+([0-9]+)} \
+	    $s j v] && $v != 0 } {
+		return 1
+	}
+
+	return 0
+}
+
+variable BIGCARS	[big_cars]
+
 #############################################################################
 #############################################################################
 
 # (TODO) check if the speed can be increased
+# The length follows STREAM_BIG_CARS: 208 fits the largest car
+# The id changes with any incompatible change of the messages or commands
+# (0x00010023: the status, stream, and EOT layouts of the streaming work),
+# so the mismatched ends fail the handshake
 
-oss_interface -id 0x00010022 -speed 230400 -length 56 \
+oss_interface -id 0x00010023 -speed 230400 \
+	-length [expr { $BIGCARS ? 208 : 56 }] \
 	-parser { parse_cmd show_msg gui_start }
 
 #############################################################################
@@ -150,6 +200,8 @@ oss_command stream 0x06 {
 #
 # Start streaming
 #
+	# codes per car (12-50 with STREAM_BIG_CARS), 0 == default (12)
+	byte	ncodes;
 	blob	confdata;
 }
 
@@ -173,6 +225,12 @@ oss_command ap 0x08 {
 	# Byte loss rate (for simulating bit [byte] errors) interpreted as
 	# times 1^-16
 	word	loss;
+	# Gilbert-Elliott (bursty) loss: the byte loss rate in the bad state,
+	# and the per-packet probabilities of the good->bad and bad->good
+	# transitions (times 2^-16)
+	word	bloss;
+	word	gbtr;
+	word	bgtr;
 	
 }
 
@@ -192,6 +250,45 @@ oss_command setp 0x0a {
 	blob	params;
 }
 
+oss_command profile 0x0b {
+#
+# Get the streaming profile (tags built with STREAM_PROFILE)
+#
+	# reset the counters after reporting
+	byte	reset;
+}
+
+oss_command tdma 0x0c {
+#
+# TDMA schedule of the streaming tags sharing the channel, makes the AP the
+# coordinator broadcasting the beacons
+#
+	# cycle length in msecs, 0 == off, 0xFFFF == report
+	word	cycle;
+	# the group Ids (words) in the order of slots
+	blob	groups;
+}
+
+oss_command sync 0x0d {
+#
+# Time sync beacons for aligning the samples of the tags (the AP becomes the
+# coordinator, the beacons are those of tdma, if there is a schedule)
+#
+	# beacon interval in msecs, 0 == off, 0xFFFF == report
+	word	interval;
+}
+
+oss_command chan 0x0e {
+#
+# Channel assignment: the AP surveys the channels and reports their load, or
+# moves itself and the tag to a channel for the session (until stop)
+#
+	# survey time per channel in msecs, 0 == default
+	word	dwell;
+	# 0-7 == move, 8 == survey and move to the least loaded, 0xFF == survey
+	byte	channel;
+}
+
 #############################################################################
 #############################################################################
 
@@ -208,9 +305,18 @@ oss_message status 0x03 {
 	word	freemem;
 	word	minmem;
 	word	rate;
+	# achieved rate error in 1/100 samples per minute (signed)
+	word	rerr;
+	# FIFO high-water mark (samples per wakeup) while streaming
+	word	fhwm;
 	byte 	battery;
 	byte	sset;
 	byte	status;
+	# energy shares (percent) of TX, RX, sensors (the rest is the CPU)
+	byte	eshare [3];
+	# session energy in uJ, energy per sample in nJ
+	lword	energy;
+	lword	epsmp;
 }
 
 oss_message config 0x01 {
@@ -231,6 +337,7 @@ oss_message report 0x05 {
 	#		bit  7     mic present
 	#		bit  8     light present
 	#		bits 9-10  the present components of pressure
+	#		bit  11    activity summary present
 	word	layout;
 	blob	data;
 }
@@ -252,6 +359,9 @@ oss_message ap 0x08 {
 	word	nodeid;
 	byte	nretr;
 	word	loss;
+	word	bloss;
+	word	gbtr;
+	word	bgtr;
 }
 
 oss_message mreg 0x09 {
@@ -262,9 +372,79 @@ oss_message setp 0x0a {
 	blob	params;
 }
 
+oss_message profile 0x0b {
+#
+# Streaming hot-path profile (since the start of the session or the last
+# reset)
+#
+	lword	blocks;
+	lword	cars;
+	lword	eots;
+	# trains acknowledged
+	lword	acks;
+	# generator time per block (mean) and per wakeup (max), usecs
+	word	gmean;
+	word	gmax;
+	# deviation of car spacing from car_space (mean, max), usecs
+	word	jmean;
+	word	jmax;
+	# ACK round trip from the first EOT of a train (mean, max), msecs
+	word	rmean;
+	word	rmax;
+	# max duration of ACK processing, usecs
+	word	tmax;
+	# max EOTs per train
+	word	emax;
+	# histograms in percent: queue occupancy at car departures (quarters
+	# of max_queued), ACK processing time (< 100us, < 1ms, < 10ms, more),
+	# transmissions per block (1, 2, 3, more)
+	byte	qhist [4];
+	byte	thist [4];
+	byte	rhist [4];
+}
+
+oss_message tdma 0x0c {
+#
+# TDMA schedule (the AP), cycle == 0 means none
+#
+	word	cycle;
+	word	slot;
+	blob	groups;
+}
+
+oss_message sync 0x0d {
+#
+# Time sync (the AP): the current clock (RTC ticks) and the beacon interval
+# (the TDMA cycle with a schedule), 0 == off
+#
+	lword	clock;
+	word	interval;
+}
+
+oss_message chan 0x0e {
+#
+# Channel survey (the AP): the load of every channel in 1/1000 of airtime,
+# the current channel, the one being moved to (0xFF == none), and the home
+# channel
+#
+	word	dwell;
+	word	load [8];
+	byte	current;
+	byte	next;
+	byte	home;
+}
+
 oss_message sblock 0x80 {
 #
-# A streaming block
+# A streaming block (12 codes, or as many as set by stream -size)
+#
+	lword	data [12];
+}
+
+oss_message mblock 0x82 {
+#
+# A streaming block of microphone levels (2 levels per code, the size as
+# for sblock)
 #
 	lword	data [12];
 }
@@ -277,6 +457,11 @@ oss_message etrain 0x81 {
 	word	offset;
 	byte	voltage;
 	byte	flags;
+	# time sync (flags & 0x08): the coordinator's clock (RTC ticks) when
+	# block sblock + sfrac/65536 was being sampled
+	lword	sblock;
+	lword	sclock;
+	word	sfrac;
 }
 
 # streaming blocks interpreted separately (in a non-standard way)
@@ -336,6 +521,26 @@ proc parse_loss { sel } {
 	return $bp
 }
 
+proc parse_prob { sel } {
+#
+# A probability converted to a word (times 2^-16)
+#
+	set val [oss_parse -skip -number -return 1]
+
+	if { $val == "" || $val < 0.0 || $val > 1.0 } {
+		error "$sel, illegal probability, $val"
+	}
+
+	set bp [expr { int ($val * 65536.0) }]
+
+	if { $bp > 65534 } {
+		# 0xFFFF means "unchanged"
+		set bp 65534
+	}
+
+	return $bp
+}
+
 proc parse_empty { } {
 
 	set cc [oss_parse -skip " \t," -match ".*" -return 1]
@@ -397,6 +602,10 @@ set CMDS(status)	"parse_cmd_status"
 set CMDS(ap)		"parse_cmd_ap"
 set CMDS(mreg)		"parse_cmd_mreg"
 set CMDS(setp)		"parse_cmd_setp"
+set CMDS(profile)	"parse_cmd_profile"
+set CMDS(tdma)		"parse_cmd_tdma"
+set CMDS(sync)		"parse_cmd_sync"
+set CMDS(chan)		"parse_cmd_chan"
 
 variable LASTCMD	""
 
@@ -404,6 +613,9 @@ variable CTiming	0
 
 variable StrFD		""
 
+# Frame capture (for INTERFACE/replay.tcl)
+variable FrmFD		""
+
 proc parse_cmd { line } {
 
 	variable CMDS
@@ -608,6 +820,22 @@ proc parse_cmd_status { } {
 	oss_issuecommand 0x03 [oss_setvalues [list 3] "status"]
 }
 
+proc parse_cmd_profile { } {
+
+	set rs 0
+	set tp [parse_selector]
+
+	if { $tp != "" } {
+		# the only option
+		oss_keymatch $tp { "reset" }
+		set rs 1
+	}
+
+	parse_empty
+
+	oss_issuecommand 0x0b [oss_setvalues [list $rs] "profile"]
+}
+
 proc parse_cmd_on { } {
 
 	parse_cmd_on_off 0x80
@@ -691,7 +919,9 @@ proc parse_cmd_sample { } {
 proc parse_cmd_stream { } {
 
 	variable StrFD
+	variable FrmFD
 	variable CPARAMS
+	variable BIGCARS
 
 	# check for file name (occurring anywhere) and handle it before the
 	# sensor specific arguments
@@ -725,6 +955,22 @@ proc parse_cmd_stream { } {
 		set StrFD $fd
 	}
 
+	# frame capture: all incoming messages (as passed to show_msg), so
+	# the session can be replayed through the host pipeline
+	set ff [oss_parse -match \
+		{-(frames|frame|fram|fra|fr)[[:space:]]+([^-][^[:space:]]*)}]
+
+	if { $ff != "" } {
+		if { $FrmFD != "" } {
+			error "a frame capture is already in progress"
+		}
+		if [catch { open [lindex $ff 2] "w" } fd] {
+			error "cannot open [lindex $ff 2], $fd"
+		}
+		fconfigure $fd -buffering full -translation lf
+		set FrmFD $fd
+	}
+
 	# check for limit
 	set lm [oss_parse -match {-(li|lim|limi|limit)[[:space:]]+} -then \
 		-number -return 2]
@@ -742,6 +988,33 @@ proc parse_cmd_stream { } {
 	# last-received block number
 	set CPARAMS(0,B) 0
 
+	# car size (codes per car, above 12 with STREAM_BIG_CARS only)
+	set nc [oss_parse -match {-(si|siz|size)[[:space:]]+} -then -number \
+		-return 2]
+
+	if { $nc != "" } {
+		if $BIGCARS {
+			if [catch { oss_valint $nc 12 50 } nc] {
+				error "illegal -size, must be 12-50"
+			}
+		} elseif [catch { oss_valint $nc 12 12 } nc] {
+			error "illegal -size, must be 12 (the praxis is built\
+				without STREAM_BIG_CARS)"
+		}
+	} else {
+		set nc 0
+	}
+
+	# microphone levels (interval in msecs)
+	set mi [oss_parse -match {-(mi|mic)[[:space:]]+} -then -number \
+		-return 2]
+
+	if { $mi != "" } {
+		if [catch { oss_valint $mi 0 8192 } mi] {
+			error "illegal -mic, must be 0-8192"
+		}
+	}
+
 	# let this update the complete local-side config
 	set rs [do_config "imu"]
 
@@ -754,12 +1027,31 @@ proc parse_cmd_stream { } {
 		# they are all single-byte
 		lappend rs $p
 	}
-	oss_issuecommand 0x06 [oss_setvalues [list $rs] "stream"]
+
+	set bb $rs
+	if { $mi != "" } {
+		# microphone, parameter 1 (stream) only, two bytes
+		lappend bb 1 0x02 [expr { ($mi >> 8) & 0xff }] \
+			[expr { $mi & 0xff }]
+	}
+
+	oss_issuecommand 0x06 [oss_setvalues [list $nc $bb] "stream"]
 	set tm [timing_start]
 
+	# the car size as used by the node
+	if { $nc == 0 } {
+		set nc 12
+	}
+
 	if { $StrFD != "" } {
-		# the header: time, seonsor conf, limit
-		puts $StrFD "$tm [join [lrange $rs 2 end]] $CPARAMS(0,L)\
+		# the header: time, seonsor conf, limit, car size
+		puts $StrFD "$tm [join [lrange $rs 2 end]] $CPARAMS(0,L) $nc\
+			[clock format [expr { $tm / 1000 }]]"
+	}
+
+	if { $FrmFD != "" } {
+		# the same header
+		puts $FrmFD "$tm [join [lrange $rs 2 end]] $CPARAMS(0,L) $nc\
 			[clock format [expr { $tm / 1000 }]]"
 	}
 }
@@ -767,6 +1059,7 @@ proc parse_cmd_stream { } {
 proc issue_stop { } {
 
 	variable StrFD
+	variable FrmFD
 
 	oss_issuecommand 0x07 [oss_setvalues [list 0] "stop"]
 
@@ -774,6 +1067,11 @@ proc issue_stop { } {
 		catch { close $StrFD }
 		set StrFD ""
 	}
+
+	if { $FrmFD != "" } {
+		catch { close $FrmFD }
+		set FrmFD ""
+	}
 }
 
 proc parse_cmd_stop { } {
@@ -849,6 +1147,9 @@ proc parse_cmd_ap { } {
 	# unused
 	set nodeid 0xFFFF
 	set loss 0xFFFF
+	set bloss 0xFFFF
+	set gbtr 0xFFFF
+	set bgtr 0xFFFF
 	set nretr 0xFF
 	set raw $RAW
 	set halt 0xFF
@@ -860,7 +1161,8 @@ proc parse_cmd_ap { } {
 			break
 		}
 
-		set k [oss_keymatch $tp { "node" "retries" "loss" "raw" "halt" }]
+		set k [oss_keymatch $tp { "node" "retries" "loss" "bloss" "gb"
+			"bg" "raw" "halt" }]
 
 		if [info exists handled($k)] {
 			error "duplicate -$k"
@@ -878,6 +1180,21 @@ proc parse_cmd_ap { } {
 			continue
 		}
 
+		if { $k == "bloss" } {
+			set bloss [parse_loss "-bloss"]
+			continue
+		}
+
+		if { $k == "gb" } {
+			set gbtr [parse_prob "-gb"]
+			continue
+		}
+
+		if { $k == "bg" } {
+			set bgtr [parse_prob "-bg"]
+			continue
+		}
+
 		if { $k == "raw" } {
 			set raw [parse_value "-raw" 0 1]
 			continue
@@ -896,13 +1213,159 @@ proc parse_cmd_ap { } {
 	set RAW $raw
 
 	oss_issuecommand 0x08 \
-		[oss_setvalues [list $nodeid $nretr $halt $loss] "ap"]
+		[oss_setvalues [list $nodeid $nretr $halt $loss $bloss $gbtr \
+			$bgtr] "ap"]
+}
+
+proc parse_cmd_tdma { } {
+#
+# tdma -cycle msecs -groups g,g,...	the AP coordinates the schedule
+# tdma -off				no schedule
+# tdma					report
+#
+	set cycle 0xFFFF
+	set gl ""
+
+	while 1 {
+
+		set tp [parse_selector]
+		if { $tp == "" } {
+			break
+		}
+
+		set k [oss_keymatch $tp { "cycle" "groups" "off" }]
+
+		if [info exists handled($k)] {
+			error "duplicate -$k"
+		}
+
+		set handled($k) ""
+
+		if { $k == "off" } {
+			set cycle 0
+			continue
+		}
+
+		if { $k == "cycle" } {
+			set cycle [parse_value "-cycle" 16 65534]
+			continue
+		}
+
+		# separated by commas or spaces, up to the next option
+		while { [set c [oss_parse -skip " \t," -return 0]] != "" &&
+		    $c != "-" } {
+			lappend gl [parse_value "-groups" 1 65534]
+		}
+	}
+
+	parse_empty
+
+	if [info exists handled(off)] {
+		if { [array size handled] > 1 } {
+			error "-off excludes other options"
+		}
+	} elseif { $gl != "" } {
+		if ![info exists handled(cycle)] {
+			error "-cycle required"
+		}
+		if { [llength $gl] > 8 } {
+			error "too many groups, max is 8"
+		}
+		if { [llength [lsort -unique $gl]] != [llength $gl] } {
+			error "duplicate groups"
+		}
+	} elseif [info exists handled(cycle)] {
+		error "-groups required"
+	}
+
+	set bb ""
+	foreach g $gl {
+		lappend bb [expr { $g & 0xff }] [expr { ($g >> 8) & 0xff }]
+	}
+
+	oss_issuecommand 0x0c [oss_setvalues [list $cycle $bb] "tdma"]
+}
+
+proc parse_cmd_sync { } {
+#
+# sync -interval msecs			the AP sends sync beacons
+# sync -off				no sync beacons
+# sync					report
+#
+	set intv 0xFFFF
+
+	set tp [parse_selector]
+
+	if { $tp != "" } {
+		set k [oss_keymatch $tp { "interval" "off" }]
+		if { $k == "off" } {
+			set intv 0
+		} else {
+			set intv [parse_value "-interval" 64 8192]
+		}
+	}
+
+	parse_empty
+
+	oss_issuecommand 0x0d [oss_setvalues [list $intv] "sync"]
+}
+
+proc parse_cmd_chan { } {
+#
+# chan -channel n [-dwell msecs]	move the tag and the AP to channel n
+# chan -auto [-dwell msecs]		survey, move to the least loaded
+# chan [-dwell msecs]			survey, report the load
+#
+	set chan 0xFF
+	set dwell 0
+
+	while 1 {
+
+		set tp [parse_selector]
+		if { $tp == "" } {
+			break
+		}
+
+		set k [oss_keymatch $tp { "channel" "auto" "dwell" }]
+
+		if [info exists handled($k)] {
+			error "duplicate -$k"
+		}
+
+		set handled($k) ""
+
+		if { $k == "auto" } {
+			set chan 8
+			continue
+		}
+
+		if { $k == "channel" } {
+			set chan [parse_value "-channel" 0 7]
+			continue
+		}
+
+		set dwell [parse_value "-dwell" 32 1024]
+	}
+
+	parse_empty
+
+	if { [info exists handled(auto)] && [info exists handled(channel)] } {
+		error "-auto and -channel are exclusive"
+	}
+
+	oss_issuecommand 0x0e [oss_setvalues [list $dwell $chan] "chan"]
 }
 
 ###############################################################################
 				
 proc show_msg { code ref msg } {
 
+	variable FrmFD
+
+	if { $FrmFD != "" } {
+		puts $FrmFD "[timing] F: $code $ref [binary encode hex $msg]"
+	}
+
 	if { $code == 0 } {
 		# ACK or NAK
 		if { $ref != 0 } {
@@ -927,6 +1390,11 @@ proc show_msg { code ref msg } {
 		return
 	}
 
+	if { $code == 130 } {
+		show_mblock $ref $msg
+		return
+	}
+
 	set str [oss_getmsgstruct $code name]
 
 	if { $str == "" } {
@@ -988,7 +1456,7 @@ proc sensor_names { act } {
 proc show_msg_status { msg } {
 
 	lassign [oss_getvalues $msg "status"] upt tak fov mfa qdr plo frm \
-		mim rat bat sns sta
+		mim rat rer fhw bat sns sta esh ene eps
 
 	if { $sta == 0 } {
 		set sta "IDLE"
@@ -1001,11 +1469,25 @@ proc show_msg_status { msg } {
 	set res "Node status ([get_rss $msg]):\n"
 	append res "  Uptime:      [sectoh $upt]\n"
 	append res "  Battery:     [sensor_to_voltage $bat]V\n"
-	append res "  SStats:      F: $fov M: $mfa Q: $qdr P: $plo\n"
+	append res "  SStats:      F: $fov M: $mfa Q: $qdr P: $plo H: $fhw\n"
 	append res "  Memory:      F: $frm M: $mim\n"
 	append res "  Status:      $sta\n"
 	append res "  Active:      [sensor_names $sns]\n"
 	append res "  Taken:       $tak @ $rat\n"
+	if { $sta == "SAMPLING" } {
+		if [expr { $rer & 0x8000 }] {
+			set rer [expr { $rer - 65536 }]
+		}
+		append res "  Rate error:  [format %1.2f \
+			[expr { $rer / 100.0 }]] per minute\n"
+	}
+	if { $ene } {
+		lassign $esh etx erx ese
+		append res "  Energy:      [format %1.3f [expr { $ene / 1000.0 }]]mJ,\
+			[format %1.2f [expr { $eps / 1000.0 }]]uJ per sample\n"
+		append res "  Shares:      TX: $etx% RX: $erx% S: $ese%\
+			CPU: [expr { 100 - $etx - $erx - $ese }]%\n"
+	}
 
 	oss_out $res
 }
@@ -1105,13 +1587,22 @@ proc show_msg_config { msg } {
 
 proc show_msg_report { msg } {
 
+	variable OSSDEC
+
+	if $OSSDEC {
+		variable RAW
+		oss_out [ossdec::report $msg $RAW]
+		return
+	}
+
 	lassign [oss_getvalues $msg "report"] sample layout data
 
 	# The "layout" layout:
 	#
-	#	uuuuupplmhhiiiii
+	#	uuuuapplmhhiiiii
 	#
 	#	u - unused
+	#	a - activity summary
 	#	i - imu components mtcga (m == motion, other bits ignored)
 	#	... and so on
 
@@ -1141,6 +1632,10 @@ proc show_msg_report { msg } {
 		append res [show_report_light data]
 	}
 
+	if [expr { ($layout >> 11) & 0x1 }] {
+		append res [show_report_activity data]
+	}
+
 	oss_out $res
 }
 
@@ -1444,6 +1939,25 @@ proc show_report_mic { d } {
 	return $res
 }
 
+proc show_report_activity { d } {
+#
+# Time spent resting, walking, trotting, running since the last report
+# (msecs), and the step count
+#
+	upvar $d data
+
+	set res " ACT:"
+
+	foreach s { "R" "W" "T" "U" } {
+		set t [get_u32 data]
+		append res " $s [format %1.1f [expr { $t / 1000.0 }]]"
+	}
+
+	append res " \[S [get_n16 data]\]"
+
+	return $res
+}
+
 proc show_report_light { d } {
 
 	upvar $d data
@@ -1479,17 +1993,101 @@ proc show_msg_ap { msg } {
 
 	variable RAW
 
-	lassign [oss_getvalues $msg "ap"] nodeid nretr loss
+	lassign [oss_getvalues $msg "ap"] nodeid nretr loss bloss gbtr bgtr
 
 	set res "AP status:\n"
 	append res "  Node Id (-node):                   $nodeid\n"
 	append res "  Copies of cmd packet (-retries):   $nretr\n"
 	append res "  Loss (packets per 1024):           $loss\n"
+	append res "  Bad state loss (-bloss):           $bloss\n"
+	append res "  Good->bad, bad->good (-gb, -bg):   [format %1.5f \
+		[expr { $gbtr / 65536.0 }]] [format %1.5f \
+		[expr { $bgtr / 65536.0 }]]\n"
 	append res "  Raw:                               $RAW\n"
 
 	oss_out $res
 }
 
+proc percents { hl } {
+
+	set res ""
+	foreach v $hl {
+		append res [format " %3u%%" $v]
+	}
+	return $res
+}
+
+proc show_msg_profile { msg } {
+
+	lassign [oss_getvalues $msg "profile"] blo car eot ack gme gmx jme \
+		jmx rme rmx tmx emx qhi thi rhi
+
+	set res "Streaming profile:\n"
+	append res "  Blocks:      $blo, cars: $car\
+		([format %1.3f [expr { $blo ? double ($car) / $blo : 0 }]]\
+		per block)\n"
+	append res "  Trains:      $ack, EOTs: $eot\
+		([format %1.2f [expr { $ack ? double ($eot) / $ack : 0 }]]\
+		per train, max $emx)\n"
+	append res "  Generator:   $gme us per block, max $gmx us\n"
+	append res "  Car jitter:  $jme us, max $jmx us\n"
+	append res "  ACK RTT:     $rme ms, max $rmx ms\n"
+	append res "  ACK proc:    max $tmx us,\
+		\[<100us <1ms <10ms more\]:[percents $thi]\n"
+	append res "  Queue:       \[<1/4 <1/2 <3/4 full\]:[percents $qhi]\n"
+	append res "  Sends/block: \[1 2 3 more\]:[percents $rhi]\n"
+
+	oss_out $res
+}
+
+proc show_msg_tdma { msg } {
+
+	lassign [oss_getvalues $msg "tdma"] cycle slot bb
+
+	if { $cycle == 0 } {
+		oss_out "TDMA: no schedule"
+		return
+	}
+
+	set gl ""
+	foreach { l h } $bb {
+		lappend gl [expr { $l | ($h << 8) }]
+	}
+
+	oss_out "TDMA: cycle $cycle ms, slot $slot ms, groups: [join $gl ,]"
+}
+
+proc show_msg_sync { msg } {
+
+	lassign [oss_getvalues $msg "sync"] clock intv
+
+	if { $intv == 0 } {
+		set intv "off"
+	} else {
+		set intv "every $intv ms"
+	}
+
+	oss_out "Sync: $intv, clock $clock"
+}
+
+proc show_msg_chan { msg } {
+
+	lassign [oss_getvalues $msg "chan"] dwell load cur nxt home
+
+	set res "Channels: current $cur, home $home"
+	if { $nxt != 0xFF } {
+		append res ", moving to $nxt"
+	}
+	append res "\n  Load (dwell $dwell ms):"
+	set c 0
+	foreach l $load {
+		append res [format " %d:%.1f%%" $c [expr { $l / 10.0 }]]
+		incr c
+	}
+
+	oss_out $res
+}
+
 proc show_msg_mreg { msg } {
 
 	lassign [oss_getvalues $msg "mreg"] data
@@ -1527,46 +2125,84 @@ proc oss_out { msg } {
 # An add on for showing streaming accel data
 ###############################################################################
 
-proc show_sblock { ref dat } {
+proc show_sblock { ref dat { tp "B" } } {
 
 	variable StrFD
 	variable CPARAMS
+	variable OSSDEC
 
-	set dat [lindex [oss_getvalues $dat "sblock"] 0]
-
-	set bn $ref
-
-	set sh 8
-	set fm ""
-	for { set i 0 } { $i < 12 } { incr i } {
-		set ci [lindex $dat $i]
-		append fm " [format %08X $ci]"
-		set b [expr {  $ci        & 0x0003 }]
-		set bn [expr { $bn |   ($b << $sh) }]
-		incr sh 2
+	if $OSSDEC {
+		lassign [ossdec::sblock $ref $dat] bn fm
+	} else {
+		# the car size is not fixed (stream -size): as many codes
+		# as there are in the message (the RSSI follows them)
+		set nc [expr { [string length $dat] / 4 }]
+		if { $nc < 12 } {
+			error "block too short"
+		}
+		if { $nc > 50 } {
+			set nc 50
+		}
+		binary scan $dat "iu$nc" dat
+		set bn $ref
+		set sh 8
+		set fm ""
+		for { set i 0 } { $i < $nc } { incr i } {
+			set ci [lindex $dat $i]
+			append fm " [format %08X $ci]"
+			if { $i < 12 } {
+				set b [expr {  $ci        & 0x0003 }]
+				set bn [expr { $bn |   ($b << $sh) }]
+				incr sh 2
+			}
+		}
 	}
 
 	if { $StrFD != "" } {
-		puts $StrFD "[timing] B: $bn$fm"
+		puts $StrFD "[timing] $tp: $bn$fm"
 	}
-	oss_out "B: [format %10u $bn]"
+	oss_out "$tp: [format %10u $bn]"
 
 	if { $bn > $CPARAMS(0,B) } {
 		set CPARAMS(0,B) $bn
 	}
 }
 
+proc show_mblock { ref dat } {
+#
+# Microphone levels: same block numbering as accel blocks, the raw line
+# is marked A
+#
+	show_sblock $ref $dat "A"
+}
+
 proc show_eot { ref dat } {
 
 	variable StrFD 
 	variable CPARAMS
+	variable OSSDEC
 
-	lassign [oss_getvalues $dat "etrain"] last offset bat flg
-	set bat [sensor_to_voltage $bat]
-	set flg [format %02X $flg]
+	if $OSSDEC {
+		lassign [ossdec::etrain $dat] last offset bat flg sbn scl sfr
+	} else {
+		if { [string length $dat] < 18 } {
+			# an older EOT without the time sync fields (the RSSI
+			# follows the first 8 bytes)
+			set dat "[string range $dat 0 7][string repeat \x00 10]"
+		}
+		lassign [oss_getvalues $dat "etrain"] last offset bat flg \
+			sbn scl sfr
+		set bat [sensor_to_voltage $bat]
+		set flg [format %02X $flg]
+	}
 
 	if { $StrFD != "" } {
-		puts $StrFD "[timing] E: $last $offset $bat $flg"
+		set ln "[timing] E: $last $offset $bat $flg"
+		if { [expr 0x$flg & 0x08] } {
+			# the time sync mapping (for assembler -s)
+			append ln " $sbn $sfr $scl"
+		}
+		puts $StrFD $ln
 	}
 
 	oss_out "E: [format %10u $last] [format %5u $offset]\
@@ -1957,6 +2593,7 @@ proc startstop { on } {
 proc cbclick { args } {
 
 	variable StrFD
+	variable FrmFD
 
 	set str [join $args]
 
@@ -1966,6 +2603,9 @@ proc cbclick { args } {
 	}
 
 	puts $StrFD "[timing] M: $str"
+	if { $FrmFD != "" } {
+		puts $FrmFD "[timing] M: $str"
+	}
 	oss_out "Mark: $str"
 }
 
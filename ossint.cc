@@ -16,6 +16,7 @@
 #include "rf.h"
 #include "sensing.h"
 #include "sampling.h"
+#include "energy.h"
 #include "ledsignal.h"
 
 void ossint_motion_event (address values, word events) {
@@ -44,15 +45,22 @@ word ossint_send_status () {
 //	lword	fover;
 //	lword	mfail;
 //	lword	qdrop;
+//	lword	ploss;
 //	word	freemem;
 //	word	mnimem;
 //	word	rate;		[Samples/Takes per minute]
+//	word	rerr;		[Rate error, 1/100 samples per minute]
+//	word	fhwm;		[FIFO high-water mark]
 //	byte	battery;
 //	byte	sset;		[ON sensors]
 //	byte	status;		[doing what]
+//	byte	eshare [3];	[energy shares of TX, RX, sensors, percent]
+//	lword	energy;		[uJ since the session start]
+//	lword	epsmp;		[nJ per sample]
 //
 	address msg;
 	message_status_t *pmt;
+	byte es [EN_NCOMPS];
 
 	if ((msg = osscmn_xpkt (message_status_code, LastRef,
 	    sizeof (message_status_t))) == NULL)
@@ -66,9 +74,17 @@ word ossint_send_status () {
 	pmt->qdrop = StreamStats . queue_drops;
 	pmt->freemem = memfree (0, &(pmt->minmem));
 	pmt->rate = SamplesPerMinute;
+	pmt->rerr = (Status == STATUS_SAMPLING) ? (word) SampleRateError : 0;
+	pmt->fhwm = StreamStats . fifo_hwm;
 	pmt->battery = VOLTAGE;
 	pmt->sset = Sensors;
 	pmt->status = Status;
+	pmt->energy = energy_total (es);
+	pmt->eshare [0] = es [EN_TX];
+	pmt->eshare [1] = es [EN_RX];
+	pmt->eshare [2] = es [EN_SENSORS];
+	pmt->epsmp = SamplesTaken ? (pmt->energy / SamplesTaken) * 1000 +
+		((pmt->energy % SamplesTaken) * 1000) / SamplesTaken : 0;
 
 	tcv_endpx (msg, YES);
 
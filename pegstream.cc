@@ -184,7 +184,7 @@ static inline Boolean add_ack (lword bn) {
 	if (aibm >= 0) {
 		// A bitmap is open, aibm points to the next bit, aend stays
 		// put at the bitmap byte, alst is the last set bn
-		if (bn - alst < 7 - aibm) {
+		if (bn - alst < (lword)(7 - aibm)) {
 			// Falls within the current map
 			aibm += (bn - alst);
 			ackb [aend] |= (1 << aibm);
@@ -241,7 +241,7 @@ void pegstream_tally_block (byte ref, address pkt) {
 //
 // Update the bit map upon block reception
 //
-	lword bn, bo;
+	lword bn;
 	sint bb;
 
 	// Decode the block number
@@ -320,3 +320,88 @@ void pegstream_eot (byte ref, address pkt) {
 		tcv_endpx (msg, NO);
 	}
 }
+
+// ============================================================================
+// Coordinator: the TDMA schedule set by the tdma command, the sync interval
+// set by the sync command, and the beacons
+// ============================================================================
+
+strbcn_t	Schedule;
+word		ScheduleSlots;		// Zero == no schedule
+word		SyncInterval;		// Zero == no sync beacons
+
+static byte	BSeq;
+
+word pegstream_tdma (word cycle, const byte *gl, word size) {
+//
+// Set up the schedule: the cycle length (msecs) and the list of groups
+// (little-endian words) in the order of slots; cycle == 0 removes it
+//
+	strbcn_t sc;
+	word n, i;
+
+	if (cycle == 0) {
+		ScheduleSlots = 0;
+		return ACK_OK;
+	}
+
+	if ((n = size / 2) == 0 || n > STRM_TDMA_MAX_SLOTS ||
+	    cycle <= STRM_TDMA_GUARD)
+		return ACK_PARAM;
+
+	// The tail of every slot is taken by the EOT and the ACK, so a slot
+	// must be at least twice as long
+	if ((sc . slot = (cycle - STRM_TDMA_GUARD) / n) < 2 * STRM_TDMA_TAIL)
+		return ACK_PARAM;
+
+	for (i = 0; i < n; i++) {
+		sc . groups [i] = gl [i + i] | ((word) gl [i + i + 1] << 8);
+		if (sc . groups [i] == 0 || sc . groups [i] == WNONE)
+			return ACK_PARAM;
+	}
+
+	sc . cycle = cycle;
+	Schedule = sc;
+	ScheduleSlots = n;
+	return ACK_OK;
+}
+
+word pegstream_sync (word interval) {
+//
+// Set up the sync beacons (msecs), interval == 0 turns them off; with a
+// schedule, the beacons go at the TDMA cycle
+//
+	if (interval != 0 && (interval < STRM_SYNC_MIN ||
+	    interval > STRM_SYNC_MAX))
+		return ACK_PARAM;
+
+	SyncInterval = interval;
+	return ACK_OK;
+}
+
+address pegstream_beacon () {
+//
+// Returns the next beacon to broadcast (NULL if not coordinating or no
+// memory); the clock is stamped as late as possible
+//
+	address msg;
+	word len;
+
+	if (!pegstream_coordinating ())
+		return NULL;
+
+	len = sizeof (strbcn_t) - (STRM_TDMA_MAX_SLOTS - ScheduleSlots) *
+		sizeof (word);
+
+	if ((msg = osscmn_xpkt (MESSAGE_CODE_BEACON, BSeq, len)) != NULL) {
+		if (ScheduleSlots == 0) {
+			// Sync only
+			Schedule . cycle = Schedule . slot = 0;
+		}
+		Schedule . clock = strm_ticks ();
+		memcpy (pkt_payload (msg), &Schedule, len);
+		BSeq++;
+	}
+
+	return msg;
+}
@@ -16,8 +16,20 @@
 void pegstream_init ();
 void pegstream_tally_block (byte, address);
 void pegstream_eot (byte, address);
+word pegstream_tdma (word, const byte*, word);
+word pegstream_sync (word);
+address pegstream_beacon ();
 
 extern word loss_count;
+extern strbcn_t Schedule;
+extern word ScheduleSlots, SyncInterval;
+
+// Sending beacons (TDMA or sync), the Peg doesn't talk to any Tag then
+#define	pegstream_coordinating()	(ScheduleSlots || SyncInterval)
+
+// The beacon interval (msecs)
+#define	pegstream_binterval()	(ScheduleSlots ? Schedule . cycle : \
+					SyncInterval)
 
 #endif
 
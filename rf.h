@@ -22,8 +22,21 @@
 // Packet offsets and casts
 // ============================================================================
 
+#if STREAM_BIG_CARS
+// Note that CC1350_MAXPLEN = 250; this accommodates the largest streaming
+// car (STRM_MAX_NCODES x 4 + PKT_FRAME_ALL), the Peg forwards it over the
+// UART as is
+#define	MAX_PACKET_LENGTH		208
+#if OSS_PACKET_LENGTH < MAX_PACKET_LENGTH && !defined (__HOSTSIM__)
+// (HOSTSIM has no UART)
+#error "ossi.h is out of date, regenerate it from ossi.tcl"
+#endif
+#else
 // Note that CC1350_MAXPLEN = 250, we can play with this
 #define	MAX_PACKET_LENGTH		64
+#endif
+// ossi.tcl sets the length from STREAM_BIG_CARS
+#define	UART_PACKET_LENGTH		OSS_PACKET_LENGTH
 // Trailer length
 #define	PKT_FRAME_TRAIL			2
 // PHY header
@@ -41,6 +54,11 @@
 						PKT_FRAME_OSS)/2))
 #define	GROUP_ID		((word)(host_id >> 16))
 
+// Bit rate (RADIO_DEFAULT_BITRATE) and the per-packet overhead (preamble,
+// sync, length, CRC) in bytes, for the airtime of packets
+#define	RF_BITRATE		50000
+#define	RF_FRAME_OVERHEAD	10
+
 // ============================================================================
 // ACK codes
 // ============================================================================
@@ -63,19 +81,25 @@
 // RF duty cycling
 extern	byte RadioActiveCD;
 #define	mark_active	RadioActiveCD = 0
+// Energy accounting (energy.h)
+void	energy_tx (word);
+#define	mark_tx(msg)	energy_tx (tcv_left (msg))
 #else
 #define	mark_active	CNOP
+#define	mark_tx(msg)	CNOP
 #endif
 
 #define	set_lbt(pkt,boo)	set_pxopts (pkt, 0, boo, RADIO_DEFAULT_POWER)
 
 #if (RADIO_OPTIONS & RADIO_OPTION_PXOPTIONS)
 #define	tcv_endpx(msg,boo)	do { set_lbt (msg, boo); \
+				     mark_tx (msg); \
 				     tcv_endp (msg); \
 				     mark_active; \
 				} while (0)
 #else
-#define	tcv_endpx(msg,boo)	do { tcv_endp (msg); mark_active; } while (0)
+#define	tcv_endpx(msg,boo)	do { mark_tx (msg); tcv_endp (msg); \
+					mark_active; } while (0)
 #endif
 
 #endif
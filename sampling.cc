@@ -11,23 +11,50 @@
 #include "ossint.h"
 #include "sensing.h"
 #include "sampling.h"
+#include "energy.h"
 
 lword	SamplesTaken;		// Samples taken so far
 word	SamplesPerMinute;	// Target rate
-
-static lword	SampleStartSecond;	// When sampling started
-static word	SampleSpace;		// Adjustable space to meet target rate
+sint	SampleRateError;	// Achieved minus target, 1/100 samples/minute
+
+// The inter-sample space is kept in 16.16 fixed point (msecs); the fraction
+// is carried over from sample to sample by the phase accumulator, so the
+// average space is exact, even though each delay is in whole msecs
+static lword	SampleSpace,		// Adjustable space to meet target rate
+		SamplePhase;		// Accumulated fraction
+static lint	SampleOverhead;		// Per-sample time not spent in delay
+static word	SamplePeriod;		// Correction period in seconds
+
+// The first sample observed in a new second (by the generator) and the
+// sample count at that point; this is accurate to one sample
+static lword	SampleMarkSecond, SampleMarkCount;
+// Reference mark (the first one) and the previous mark seen by the corrector
+static lword	RefSecond, RefCount, CorrSecond, CorrCount;
 
 // ============================================================================
 
+#ifndef	__HOSTSIM__
+
+// The host check (HOSTSIM/ratecheck.cc) drives rate_correct directly
+
+static word	SampleDelay;		// The last delay
+
 fsm sampling_generator {
 //
 // These sensors are sampled in the background: HDC1000, OPT3001, BMP280
 //
 	state SM_TAKE:
 
+		// Have the background sensors that are due read before the
+		// report, so the values are fresh
+		if (sensing_refresh (SampleDelay, SM_REPORT))
+			release;
+
+	state SM_REPORT:
+
 		address msg;
 		message_report_t *pmt;
+		lword s;
 		word bl;
 
 		// Calculate the report size
@@ -36,9 +63,9 @@ fsm sampling_generator {
 		if ((msg = osscmn_xpkt (message_report_code, LastRef,
 			sizeof (message_report_t) + bl)) == NULL) {
 			// Failure, do we skip?
-			if (SampleSpace > 128) {
+			if ((SampleSpace >> 16) > 128) {
 				// Some heuristics
-				delay (16, SM_TAKE);
+				delay (16, SM_REPORT);
 				release;
 			}
 			// Just skip
@@ -53,42 +80,116 @@ fsm sampling_generator {
 
 		tcv_endpx (msg, YES);
 		SamplesTaken++;
+		energy_awake (EN_US_REPORT);
+
+		if ((s = seconds ()) != SampleMarkSecond) {
+			// First sample in this second
+			SampleMarkSecond = s;
+			SampleMarkCount = SamplesTaken;
+		}
 		
 	initial state SM_DELAY:
 
-		delay (SampleSpace, SM_TAKE);
+		SamplePhase += SampleSpace;
+		SampleDelay = (word)(SamplePhase >> 16);
+		SamplePhase &= 0xffff;
+		delay (SampleDelay, SM_TAKE);
 }
 
-fsm sampling_corrector {
+#endif	/* __HOSTSIM__ */
 
-	lword NextMinuteBoundary;
+static void rate_correct () {
+//
+// Recalculates the inter-sample space to eliminate the accumulated error
+// within the next correction period, accounting for the measured overhead
+//
+	lword s, n, e, a;
+	lint err, d;
+
+	if ((n = SampleMarkCount) == 0 || (s = SampleMarkSecond) == CorrSecond)
+		// No new mark
+		return;
+
+	if (RefCount == 0) {
+		// The first mark is the reference
+		RefSecond = CorrSecond = s;
+		RefCount = CorrCount = n;
+		return;
+	}
 
-	state STC_START:
+	// The expected count at the mark
+	e = s - RefSecond;
+	e = RefCount + (e / 60) * SamplesPerMinute +
+		((e % 60) * SamplesPerMinute) / 60;
+	err = (lint)(n - e);
+
+	if ((e = s - CorrSecond) <= 60 && (a = n - CorrCount) != 0) {
+		// The actual per-sample time over the last period (16.16)
+		a = ((e * 1024) << 16) / a;
+		// The spaces are unsigned and may not fit a lint, so take the
+		// difference in lword and bound it before the sign goes on
+		if (a >= SampleSpace) {
+			a -= SampleSpace;
+			d = a > MAX_SAMPLE_OVERHEAD ? MAX_SAMPLE_OVERHEAD :
+				(lint) a;
+		} else {
+			a = SampleSpace - a;
+			d = a > MAX_SAMPLE_OVERHEAD ? -MAX_SAMPLE_OVERHEAD :
+				-(lint) a;
+		}
+		// Smooth the overhead (the mark is accurate to one sample)
+		SampleOverhead = (SampleOverhead * 3 + d) / 4;
+	}
 
-		NextMinuteBoundary = seconds () + 60;
+	CorrSecond = s;
+	CorrCount = n;
+
+	// The number of samples to take within the next period, such that the
+	// error disappears
+	d = (lint)(((lword) SamplePeriod * SamplesPerMinute) / 60) - err;
+
+	if (d <= 0) {
+		// Way ahead of schedule
+		a = (lword) MAX_SAMPLE_SPACE << 16;
+	} else {
+		// The space in 16.16 exceeds the range of lint, so clamp it
+		// in lword
+		a = (((lword) SamplePeriod * 1024) << 16) / (lword) d;
+		if (SampleOverhead < 0)
+			a += (lword)(-SampleOverhead);
+		else if (a > (lword) SampleOverhead)
+			a -= (lword) SampleOverhead;
+		else
+			a = 0;
+		if (a > ((lword) MAX_SAMPLE_SPACE << 16))
+			a = (lword) MAX_SAMPLE_SPACE << 16;
+		else if (a < ((lword) MIN_SAMPLE_SPACE << 16))
+			a = (lword) MIN_SAMPLE_SPACE << 16;
+	}
 
-	state STC_WAIT_A_MINUTE:
+	SampleSpace = a;
 
-		lword s, t, p;
+	// Achieved rate error since the start
+	if ((e = s - RefSecond) != 0) {
+		err = (err * 6000) / (lint) e;
+		SampleRateError = err > 32767 ? 32767 :
+			(err < -32767 ? -32767 : (sint) err);
+	}
+}
 
-		// Wait until hit the next minute boundary
-		if ((s = seconds ()) < NextMinuteBoundary) {
-			delay ((word)((NextMinuteBoundary - s) * 1023),
-				STC_WAIT_A_MINUTE);
-			release;
-		}
+#ifndef	__HOSTSIM__
 
-		p = ((NextMinuteBoundary - SampleStartSecond) / 60) *
-				SamplesPerMinute;
+fsm sampling_corrector {
 
-		t = (SampleSpace * SamplesTaken) / p;
+	state STC_WAIT:
 
-		SampleSpace = t > MAX_SAMPLE_SPACE ? MAX_SAMPLE_SPACE :
-			(t < MIN_SAMPLE_SPACE ? MIN_SAMPLE_SPACE : (word) t);
+		delay (SamplePeriod * 1024, STC_CORRECT);
+		release;
 
-		NextMinuteBoundary += 60;
+	state STC_CORRECT:
 
-		delay (999, STC_WAIT_A_MINUTE);
+		rate_correct ();
+		sameas STC_WAIT;
 }
 
 // ============================================================================
@@ -97,6 +198,7 @@ void sampling_stop () {
 
 	killall (sampling_generator);
 	killall (sampling_corrector);
+	sensing_sync (NO);
 	Status = STATUS_IDLE;
 }
 
@@ -122,16 +224,31 @@ word sampling_start (const command_sample_t *pmt, word pml) {
 	else if (SamplesPerMinute > MAX_SAMPLES_PER_MINUTE)
 		SamplesPerMinute = MAX_SAMPLES_PER_MINUTE;
 
-	// Calculate a rough estimate of the inter-sample interval in msecs;
-	// we will be adjusting it to try to keep the long-term rate in samples
-	// per minute as close to the target as possible
+	// The nominal inter-sample interval in msecs (16.16); we will be
+	// adjusting it to keep the long-term rate as close to the target as
+	// possible
+	SampleSpace = ((lword)(60 * 1024) << 16) / SamplesPerMinute;
+	SamplePhase = 0;
+	SampleDelay = 0;
+	SampleOverhead = 0;
+	SampleRateError = 0;
+
+	// Correct often enough to see CORR_SAMPLES samples per period
+	SamplePeriod = (60 * CORR_SAMPLES) / SamplesPerMinute;
+	if (SamplePeriod < MIN_CORR_PERIOD)
+		SamplePeriod = MIN_CORR_PERIOD;
+	else if (SamplePeriod > MAX_CORR_PERIOD)
+		SamplePeriod = MAX_CORR_PERIOD;
 
-	SampleSpace = (60 * 1024) / SamplesPerMinute;
 	SamplesTaken = 0;
-	SampleStartSecond = seconds ();
+	energy_start ();
+	SampleMarkSecond = SampleMarkCount = 0;
+	RefSecond = RefCount = CorrSecond = CorrCount = 0;
 
 	killall (sampling_generator);
 	killall (sampling_corrector);
+	// The background sensors will be read in step with the reports
+	sensing_sync (YES);
 	if (runfsm sampling_generator) {
 		if (runfsm sampling_corrector) {
 			Status = STATUS_SAMPLING;
@@ -144,3 +261,5 @@ word sampling_start (const command_sample_t *pmt, word pml) {
 	Status = STATUS_IDLE;
 	return ACK_NORES;
 }
+
+#endif	/* __HOSTSIM__ */
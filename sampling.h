@@ -21,12 +21,21 @@
 // short-term departures are OK)
 #define	MAX_SAMPLE_SPACE	(63 * 1024)
 #define	MIN_SAMPLE_SPACE	3
+// Bound on the measured per-sample overhead (1 sec in 16.16 msecs)
+#define	MAX_SAMPLE_OVERHEAD	((lint) 1024 << 16)
+
+// The corrector runs every CORR_SAMPLES samples, but within these bounds (in
+// seconds)
+#define	CORR_SAMPLES		64
+#define	MIN_CORR_PERIOD		2
+#define	MAX_CORR_PERIOD		60
 
 #define	STATUS_SAMPLING		1
 #define	STATUS_STREAMING	2
 
 extern word SamplesPerMinute;
 extern lword SamplesTaken;
+extern sint SampleRateError;
 extern byte Status;
 
 word sampling_start (const command_sample_t*, word);
@@ -11,6 +11,12 @@
 #include "sampling.h"
 #include "streaming.h"
 #include "ossint.h"
+#include "activity.h"
+#include "energy.h"
+
+// Sensor power state changes (charged by the energy accounting)
+#define	sensors_on(f)	do { energy_update (); _BIS (Sensors, f); } while (0)
+#define	sensors_off(f)	do { energy_update (); _BIC (Sensors, f); } while (0)
 
 static const word smpl_intervals [] = {
 //
@@ -100,8 +106,9 @@ static hdc1000_desc_t hdc1000_desc;
 // OBMICROPHONE
 // ============================================================================
 
-static word obmicrophone_conf [] =       { 1500 };		// 1.5 MHz
-static const byte obmicrophone_clen [] = {    1 };
+// 1.5 MHz, level streaming interval in msecs (0 == no streaming)
+static word obmicrophone_conf [] =       { 1500, 0 };
+static const byte obmicrophone_clen [] = {    1, 1 };
 
 // ============================================================================
 // OPT3001
@@ -173,6 +180,7 @@ fsm mpu9250_sampler {
 		word values [3];
 
 		read_mpu9250 (MP_MOTION, values);
+		energy_awake (EN_US_SAMPLE);
 
 		// The number of motion events
 		mpu9250_desc.motion_events ++;
@@ -213,6 +221,10 @@ static void sensor_on_mpu9250 () {
 		// Sync data read, event type 2
 		mpu9250_desc.evtype = 2;
 		options |= MPU9250_SYNC_READ;
+		if ((mpu9250_conf [0] & 0x10) && mpu9250_conf [6] <= 1)
+			// Run the activity classifier on the readings, which
+			// must be accel only (see sensing_configure)
+			mpu9250_desc.evtype |= 0x40;
 		// Calculate and store the data rate in samples per minute
 		mpu9250_desc.rate = (mpu9250_conf [0] & 0x01) ?
 			// Low-power mode
@@ -264,9 +276,14 @@ static void sensor_on_mpu9250 () {
 		mpu9250_desc.components = 16;
 	} else {
 		mpu9250_desc.components = mpu9250_conf [6];
+		if (mpu9250_desc.evtype & 0x40) {
+			activity_start (mpu9250_desc.rate, mpu9250_conf [3]);
+			if (!running (activity_sampler))
+				runfsm activity_sampler;
+		}
 	}
 
-	_BIS (Sensors, MPU9250_FLAG);
+	sensors_on (MPU9250_FLAG);
 }
 
 static void sensor_off_mpu9250 () {
@@ -277,20 +294,179 @@ static void sensor_off_mpu9250 () {
 	mpu9250_off ();
 
 	killall (mpu9250_sampler);
+	killall (activity_sampler);
 
-	_BIC (Sensors, MPU9250_FLAG);
+	sensors_off (MPU9250_FLAG);
 }
 
 // ============================================================================
+// Background sensor scheduler
+// ============================================================================
+//
+// The background sensors (BMP280, HDC1000, OPT3001) are read by one process.
+// Their intervals are rounded up to multiples of SENSING_TICK, so sensors
+// whose intervals are multiples of one another fall due at the same tick, and
+// a sensor that is due within 1/8 of its interval is read early along with
+// the others, i.e., all due sensors are read in one wakeup. While sampling,
+// the scheduler runs no timer of its own (slave mode): the report generator
+// advances the countdowns by the report interval and has the due sensors
+// read right before the report is built.
+//
+
+typedef struct {
+	word	period;		// Tick-aligned sampling interval
+	word	left;		// Msecs until due
+} sensing_timer_t;
+
+#define	N_BACKGROUND_SENSORS	3
+// Indexes of background sensors are consecutive starting from BMP280
+#define	bgflag(i)		(BMP280_FLAG << (i))
+#define	BACKGROUND_FLAGS	(BMP280_FLAG | HDC1000_FLAG | OPT3001_FLAG)
+
+#define	tick_aligned(t)		((((t) + SENSING_TICK - 1) / SENSING_TICK) * \
+					SENSING_TICK)
+
+static sensing_timer_t	STimers [N_BACKGROUND_SENSORS];
+static word		SDelay;
+static byte		SDue, SRequest, SWait, SSlave;
+
+static byte sched_advance (word by) {
+//
+// Advances the countdowns of active sensors by the specified number of msecs,
+// returns the set of sensors that are due (or close enough)
+//
+	sensing_timer_t *st;
+	byte due;
+	sint i;
+
+	for (due = 0, i = 0; i < N_BACKGROUND_SENSORS; i++) {
+		if ((Sensors & bgflag (i)) == 0)
+			continue;
+		st = STimers + i;
+		st->left = (st->left > by) ? st->left - by : 0;
+		if (st->left <= (st->period >> 3)) {
+			due |= bgflag (i);
+			st->left = st->period;
+		}
+	}
+
+	return due;
+}
+
+static word sched_next () {
+//
+// Msecs until the nearest due sensor
+//
+	word d;
+	sint i;
+
+	for (d = WNONE, i = 0; i < N_BACKGROUND_SENSORS; i++)
+		if ((Sensors & bgflag (i)) && STimers [i].left < d)
+			d = STimers [i].left;
 
-fsm hdc1000_sampler {
+	return d;
+}
+
+fsm sensing_scheduler {
+
+	state SC_BMP280:
+
+		if (SDue & Sensors & BMP280_FLAG)
+			read_bmp280 (SC_BMP280, (address)(bmp280_desc.values));
+
+	state SC_HDC1000:
+
+		if (SDue & Sensors & HDC1000_FLAG)
+			read_hdc1000 (SC_HDC1000, hdc1000_desc.values);
+
+	state SC_OPT3001:
+
+		if (SDue & Sensors & OPT3001_FLAG)
+			read_opt3001 (SC_OPT3001, opt3001_desc.values);
+
+	initial state SC_DONE:
+
+		if (SRequest) {
+			// The report generator wants these refreshed
+			SDue = SRequest;
+			SRequest = 0;
+			sameas SC_BMP280;
+		}
+
+		SDue = 0;
+
+		if (SWait) {
+			// The report is waiting for us
+			SWait = NO;
+			trigger (&SWait);
+		}
+
+		// An early wakeup (on reconfiguration) doesn't advance the
+		// countdowns; this can only delay the other sensors a bit
+		when (&SRequest, SC_DONE);
+		if (SSlave || (Sensors & BACKGROUND_FLAGS) == 0)
+			// Driven by the reports (or about to be killed)
+			release;
 
-	state HD_LOOP:
+		delay (SDelay = sched_next (), SC_TICK);
+		release;
+
+	state SC_TICK:
 
-		read_hdc1000 (HD_LOOP, hdc1000_desc.values);
-		delay (hdc1000_desc.smplint, HD_LOOP);
+		// A wakeup of its own (not in step with the reports)
+		energy_awake (EN_US_SAMPLE);
+		SDue = sched_advance (SDelay);
+		sameas SC_BMP280;
 }
 
+static void sched_restart () {
+//
+// Called whenever the set of background sensors changes; a read in progress
+// (possibly from a sensor just turned off) is abandoned
+//
+	killall (sensing_scheduler);
+	SDue = 0;
+	SRequest &= Sensors;
+	if ((Sensors & BACKGROUND_FLAGS) || SWait)
+		// If there are no sensors, the new copy will just release the
+		// report and wait to be killed
+		runfsm sensing_scheduler;
+}
+
+void sensing_sync (Boolean slave) {
+//
+// Switch to/from slave mode (on start/stop of sampling)
+//
+	sint i;
+
+	if ((SSlave = slave))
+		// Make sure all sensors are fresh for the first report
+		for (i = 0; i < N_BACKGROUND_SENSORS; i++)
+			STimers [i].left = 0;
+
+	trigger (&SRequest);
+}
+
+Boolean sensing_refresh (word space, word st) {
+//
+// Called by the report generator before building a report; space is the
+// time since the previous report. If some sensors are due, the caller is
+// set up to resume in state st after they have been read.
+//
+	byte due;
+
+	if (!running (sensing_scheduler) || (due = sched_advance (space)) == 0)
+		return NO;
+
+	SRequest |= due;
+	SWait = YES;
+	trigger (&SRequest);
+	when (&SWait, st);
+	return YES;
+}
+
+// ============================================================================
+
 static void sensor_on_hdc1000 () {
 
 	word options;
@@ -318,10 +494,12 @@ static void sensor_on_hdc1000 () {
 
 	hdc1000_on (options);
 
-	if (!running (hdc1000_sampler))
-		runfsm hdc1000_sampler;
+	STimers [HDC1000_INDEX - BMP280_INDEX] . period =
+		tick_aligned (hdc1000_desc.smplint);
+	STimers [HDC1000_INDEX - BMP280_INDEX] . left = 0;
 
-	_BIS (Sensors, HDC1000_FLAG);
+	sensors_on (HDC1000_FLAG);
+	sched_restart ();
 }
 
 static void sensor_off_hdc1000 () {
@@ -331,9 +509,8 @@ static void sensor_off_hdc1000 () {
 
 	hdc1000_off ();
 
-	killall (hdc1000_sampler);
-
-	_BIC (Sensors, HDC1000_FLAG);
+	sensors_off (HDC1000_FLAG);
+	sched_restart ();
 }
 
 // ============================================================================
@@ -349,7 +526,7 @@ static void sensor_on_obmicrophone () {
 	// In kilohertz
 	obmicrophone_on (obmicrophone_conf [0] * 10);
 
-	_BIS (Sensors, OBMICROPHONE_FLAG);
+	sensors_on (OBMICROPHONE_FLAG);
 }
 
 static void sensor_off_obmicrophone () {
@@ -359,19 +536,11 @@ static void sensor_off_obmicrophone () {
 
 	obmicrophone_off ();
 
-	_BIC (Sensors, OBMICROPHONE_FLAG);
+	sensors_off (OBMICROPHONE_FLAG);
 }
 
 // ============================================================================
 
-fsm opt3001_sampler {
-
-	state OP_LOOP:
-
-		read_opt3001 (OP_LOOP, opt3001_desc.values);
-		delay (opt3001_desc.smplint, OP_LOOP);
-}
-
 static void sensor_on_opt3001 () {
 
 	if (opt3001_active)
@@ -388,10 +557,12 @@ static void sensor_on_opt3001 () {
 	// Sanity check included
 	opt3001_desc.smplint = opt3001_conf [2] ? opt3001_conf [2] : 1024;
 
-	if (!running (opt3001_sampler))
-		runfsm opt3001_sampler;
+	STimers [OPT3001_INDEX - BMP280_INDEX] . period =
+		tick_aligned (opt3001_desc.smplint);
+	STimers [OPT3001_INDEX - BMP280_INDEX] . left = 0;
 
-	_BIS (Sensors, OPT3001_FLAG);
+	sensors_on (OPT3001_FLAG);
+	sched_restart ();
 }
 
 static void sensor_off_opt3001 () {
@@ -401,21 +572,12 @@ static void sensor_off_opt3001 () {
 
 	opt3001_off ();
 
-	killall (opt3001_sampler);
-
-	_BIC (Sensors, OPT3001_FLAG);
+	sensors_off (OPT3001_FLAG);
+	sched_restart ();
 }
 
 // ============================================================================
 
-fsm bmp280_sampler {
-
-	state BM_LOOP:
-
-		read_bmp280 (BM_LOOP, (address)(bmp280_desc.values));
-		delay (bmp280_desc.smplint, BM_LOOP);
-}
-
 static void sensor_on_bmp280 () {
 
 	word options;
@@ -447,10 +609,12 @@ static void sensor_on_bmp280 () {
 
 	bmp280_on (options);
 
-	if (!running (bmp280_sampler))
-		runfsm bmp280_sampler;
+	STimers [BMP280_INDEX - BMP280_INDEX] . period =
+		tick_aligned (bmp280_desc.smplint);
+	STimers [BMP280_INDEX - BMP280_INDEX] . left = 0;
 
-	_BIS (Sensors, BMP280_FLAG);
+	sensors_on (BMP280_FLAG);
+	sched_restart ();
 }
 
 static void sensor_off_bmp280 () {
@@ -460,9 +624,8 @@ static void sensor_off_bmp280 () {
 
 	bmp280_off ();
 
-	killall (bmp280_sampler);
-
-	_BIC (Sensors, BMP280_FLAG);
+	sensors_off (BMP280_FLAG);
+	sched_restart ();
 }
 
 // ============================================================================
@@ -525,6 +688,12 @@ word sensing_configure (const blob *cdt, sint lft) {
 					mpu9250_clen,
 					sizeof (mpu9250_conf),
 					buf, &len);
+				if (sen == ACK_OK &&
+				    (mpu9250_conf [0] & 0x16) == 0x12 &&
+				    (mpu9250_conf [6] & 0xf) > 1)
+					// The activity classifier (sync read,
+					// no motion detect) takes accel only
+					sen = ACK_PARAM;
 				break;
 			case HDC1000_INDEX:
 				sen = configure_sensor (
@@ -611,13 +780,35 @@ word sensing_turn (byte s) {
 	if (Sensors == 0 && Status == STATUS_SAMPLING)
 		sampling_stop ();
 
-	if (!mpu9250_active && Status == STATUS_STREAMING)
+	if (Status == STATUS_STREAMING && (Sensors & StreamSet) != StreamSet)
+		// One of the streamed sensors has been turned off
 		streaming_stop ();
 
 	// Check if not void ...
 	return ACK_OK;
 }
 
+byte sensing_stream_set () {
+//
+// The set of sensors to be streamed, as implied by their configuration
+//
+	byte s;
+
+	s = 0;
+	if ((mpu9250_conf [0] & 0x16) == 0x02 && mpu9250_conf [6] <= 1)
+		// Sync read, no motion detection, no classifier, accel only
+		s |= MPU9250_FLAG;
+	if (obmicrophone_conf [OBMICROPHONE_PAR_STREAM])
+		s |= OBMICROPHONE_FLAG;
+
+	return s;
+}
+
+word sensing_mic_interval () {
+
+	return obmicrophone_conf [OBMICROPHONE_PAR_STREAM];
+}
+
 word sensing_getconf (byte *where) {
 //
 // Return the configuration of all sensors in where
@@ -740,6 +931,15 @@ word sensing_report (byte *where, address mask) {
 		}
 	}
 
+	if ((Sensors & MPU9250_FLAG) && (mpu9250_desc.evtype & 0x40)) {
+		// Activity summary since the last report
+		nb += ACTIVITY_REPORT_SIZE;
+		if (where) {
+			where += activity_report (where);
+			*mask |= 1 << 11;
+		}
+	}
+
 	return nb;
 }
 
@@ -16,6 +16,8 @@
 
 // Set to zero to disable FIFO
 #define	MPU9250_FIFO_BUFFER_SIZE		STRM_NCODES
+// Hardware FIFO capacity in accel samples (512 bytes / 6)
+#define	MPU9250_FIFO_CAPACITY			85
 
 #if defined(__SMURPH__) || !defined(MPU9250_I2C_ADDRESS)
 // The SENSORTAG-specific sensors have to be emulated if we are not running on
@@ -57,6 +59,10 @@
 
 #define	SENSOR_BATTERY		(-1)
 
+// Background sampling intervals are rounded to multiples of this (msecs), so
+// that different sensors can be read in the same wakeup
+#define	SENSING_TICK		16
+
 // Logical indexes for the application
 #define	MPU9250_INDEX		0
 #define OBMICROPHONE_INDEX	1
@@ -121,6 +127,12 @@ typedef struct {
 // OBMICROPHONE
 // ============================================================================
 
+#define	OBMICROPHONE_PAR_RATE	0
+#define	OBMICROPHONE_PAR_STREAM	1	// Level interval for streaming
+
+// Minimum interval between streamed levels (msecs)
+#define	OBMICROPHONE_MIN_STREAM	4
+
 #define	obmicrophone_active		(Sensors & OBMICROPHONE_FLAG)
 #define	obmicrophone_data_size		(obmicrophone_active ? 8 : 0)
 
@@ -161,6 +173,10 @@ word sensing_turn (byte);
 word sensing_configure (const blob*, sint);
 word sensing_getconf (byte*);
 word sensing_report (byte*, address);
+byte sensing_stream_set ();
+word sensing_mic_interval ();
+void sensing_sync (Boolean);
+Boolean sensing_refresh (word, word);
 
 #define	sensing_all_off()	sensing_turn (0x00)
 
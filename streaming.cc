@@ -9,6 +9,7 @@
 #include "tag.h"
 #include "sampling.h"
 #include "streaming.h"
+#include "energy.h"
 
 //
 // It is impossible for the queue to contain a block whose offset from the
@@ -19,10 +20,40 @@
 //
 static	lword		LastSent, LastGenerated;
 static	strblk_t	*BHead, *BTail, *CBuilt, *CCar;
-static	word		NQueued, NCars, CFill;
-static	aword		TSender;
+static	word		NQueued, NCars;
+// Codes per car (block), set by the stream command
+static	word		NCodes = STRM_NCODES;
 static	byte		TSStat, LTrain, TFlags;
 
+#ifndef	__HOSTSIM__
+// Only used by the FSMs (ptrigger ignores its arguments in the harness)
+static	strblk_t	*MBuilt;
+static	word		CFill, MFill, MicInterval;
+static	aword		TSender;
+#endif
+
+// Time sync: the last beacon (the coordinator's clock and ours at the
+// reception), the last complete block of the timed sensor, and the point
+// (the fraction of the next block, our clock) where all its samples taken
+// so far had been read
+static	lword		SyncPeg, SyncTag, SyncBlock, SyncMBlock, SyncMTime;
+static	word		SyncMFrac;
+static	Boolean		SyncOn;
+
+// The set of sensors being streamed (MPU9250_FLAG, OBMICROPHONE_FLAG)
+byte			StreamSet;
+
+// Microphone levels per block: two 15-bit levels per code
+#define	MIC_LEVELS	(NCodes * 2)
+
+// The queue limit (max_queued) and the train length are in blocks of
+// STRM_NCODES codes, so the RAM taken by the queue and the proportion of
+// trains to the queue don't depend on the car size
+#define	queue_load(n)	((lword)(n) * NCodes)
+#define	QUEUE_LIMIT	((lword) TagParams.max_queued * STRM_NCODES)
+#define	TRAIN_LENGTH	(((lword) TagParams.train_length * STRM_NCODES + \
+				NCodes - 1) / NCodes)
+
 // Can be used to normalize the values, e.g., for compression
 #define	ACCBIAS		0x0
 
@@ -32,6 +63,162 @@ static inline lword encode (address data) {
 	       (((lword)((data [2] + ACCBIAS) & 0xffc0)) >>  4) ;
 }
 
+#if STREAM_PROFILE
+// ============================================================================
+// Profiling of the hot paths; the times are in RTC ticks
+// ============================================================================
+
+// Ticks to usecs (1000000/65536) and to msecs (PicOS, 1/1024 s)
+#define	prof_usec(t)	((((lword)(t)) * 15625) >> 10)
+#define	prof_msec(t)	(((lword)(t)) >> 6)
+
+static struct {
+	lword	blocks, cars, eots, acks, jcount;
+	lword	gtime, jtime, rtime;		// totals
+	lword	gmax, jmax, rmax, tmax;
+	lword	qh [4], th [4], rh [4];		// histograms
+	lword	gstart, lastcar, eot0;
+	word	teots, emax;
+} Prof;
+
+static void prof_release (strblk_t *cb) {
+//
+// Transmissions per block, counted when the block leaves the queue
+//
+	if (cb -> sent)
+		Prof . rh [cb -> sent > 4 ? 3 : cb -> sent - 1] ++;
+}
+
+#define	prof_gen_start()	(Prof . gstart = strm_ticks ())
+
+static void prof_gen_end () {
+
+	lword t = strm_ticks () - Prof . gstart;
+
+	Prof . gtime += t;
+	if (t > Prof . gmax)
+		Prof . gmax = t;
+}
+
+static void prof_car () {
+//
+// A car has been sent: inter-car jitter, queue occupancy
+//
+	lword t = strm_ticks (), d;
+
+	if (NCars) {
+		// Not the first car of the train, the nominal space is
+		// car_space msecs
+		d = t - Prof . lastcar;
+		if ((d -= (lword) TagParams.car_space << 6) & 0x80000000)
+			d = -d;
+		Prof . jtime += d;
+		Prof . jcount++;
+		if (d > Prof . jmax)
+			Prof . jmax = d;
+	}
+	Prof . lastcar = t;
+	Prof . cars++;
+	Prof . qh [(queue_load (NQueued) * 4) / (QUEUE_LIMIT + 1)] ++;
+	CCar -> sent++;
+}
+
+static void prof_eot () {
+
+	if (Prof . teots++ == 0)
+		Prof . eot0 = strm_ticks ();
+	Prof . eots++;
+}
+
+static void prof_ack (lword t0) {
+//
+// A train ACK processed, t0 is when its processing started
+//
+	lword t = strm_ticks (), d;
+
+	d = t - t0;
+	if (d > Prof . tmax)
+		Prof . tmax = d;
+	// < 100us, < 1ms, < 10ms, more
+	Prof . th [d < 7 ? 0 : (d < 66 ? 1 : (d < 656 ? 2 : 3))] ++;
+
+	d = prof_msec (t0 - Prof . eot0);
+	Prof . rtime += d;
+	if (d > Prof . rmax)
+		Prof . rmax = d;
+
+	if (Prof . teots > Prof . emax)
+		Prof . emax = Prof . teots;
+	Prof . teots = 0;
+	Prof . acks++;
+}
+
+static word prof_w (lword v) {
+// Saturate
+	return v > 0xffff ? 0xffff : (word) v;
+}
+
+static void prof_hist (byte *h, const lword *c) {
+//
+// Histogram counts to percentages
+//
+	lword s;
+	sint i;
+
+	for (s = 0, i = 0; i < 4; i++)
+		s += c [i];
+	for (i = 0; i < 4; i++)
+		h [i] = s ? (byte)((c [i] * 100 + s / 2) / s) : 0;
+}
+
+word streaming_send_profile (byte reset) {
+
+	address msg;
+	message_profile_t *pmt;
+
+	if ((msg = osscmn_xpkt (message_profile_code, LastRef,
+	    sizeof (message_profile_t))) == NULL)
+		return ACK_NORES;
+
+	pmt = (message_profile_t*) pkt_payload (msg);
+	pmt->blocks = Prof . blocks;
+	pmt->cars = Prof . cars;
+	pmt->eots = Prof . eots;
+	pmt->acks = Prof . acks;
+	pmt->gmean = Prof . blocks ?
+		prof_w (prof_usec (Prof . gtime / Prof . blocks)) : 0;
+	pmt->gmax = prof_w (prof_usec (Prof . gmax));
+	pmt->jmean = Prof . jcount ?
+		prof_w (prof_usec (Prof . jtime / Prof . jcount)) : 0;
+	pmt->jmax = prof_w (prof_usec (Prof . jmax));
+	pmt->rmean = Prof . acks ? prof_w (Prof . rtime / Prof . acks) : 0;
+	pmt->rmax = prof_w (Prof . rmax);
+	pmt->tmax = prof_w (prof_usec (Prof . tmax));
+	pmt->emax = Prof . emax;
+	prof_hist (pmt->qhist, Prof . qh);
+	prof_hist (pmt->thist, Prof . th);
+	prof_hist (pmt->rhist, Prof . rh);
+
+	tcv_endpx (msg, YES);
+
+	if (reset)
+		bzero (&Prof, sizeof (Prof));
+
+	return ACK_OK;
+}
+
+#else
+
+#define	prof_release(a)		CNOP
+#define	prof_gen_start()	CNOP
+#define	prof_gen_end()		CNOP
+#define	prof_car()		CNOP
+#define	prof_eot()		CNOP
+
+#endif	/* STREAM_PROFILE */
+
+// ============================================================================
+
 static void delete_front () {
 
 	strblk_t *p;
@@ -44,6 +231,7 @@ static void delete_front () {
 		// list
 		CCar = p;
 
+	prof_release (BHead);
 	ufree (BHead);
 
 	if ((BHead = p) == NULL)
@@ -52,37 +240,51 @@ static void delete_front () {
 	NQueued--;
 }
 
-static void add_current () {
-
+static void add_block (strblk_t *cb) {
+//
+// Append a completed block (accel or mic) to the queue; the two kinds
+// share the block numbering, so the peg and the OSS handle them the same
+// way
+//
 	// Block numbering starts from 1, Last Received can be initialized to
 	// zero
-	CBuilt -> next = NULL;
-	CBuilt -> bn = ++LastGenerated;	// aka current block
+	cb -> next = NULL;
+	cb -> bn = ++LastGenerated;	// aka current block
+#if STREAM_PROFILE
+	cb -> sent = 0;
+	Prof . blocks++;
+#endif
 
 	// Make sure the queue is never longer than max and the offset
 	// is kosher
-	while (NQueued >= TagParams.max_queued ||
-	  (BHead != NULL && (LastGenerated - BHead -> bn >=
-	    STRM_MAX_BLOCKSPAN))) {
+	while (BHead != NULL && (queue_load (NQueued + 1) > QUEUE_LIMIT ||
+	  LastGenerated - BHead -> bn >= STRM_MAX_BLOCKSPAN)) {
 		delete_front ();
 		StreamStats . queue_drops ++;
 		TFlags |= STRM_TFLAG_QDR;
 	}
 
 	if (BTail == NULL)
-		BHead = BTail = CBuilt;
+		BHead = BTail = cb;
 	else
-		BTail = (BTail -> next = CBuilt);
+		BTail = (BTail -> next = cb);
 
 	if (CCar == NULL) {
-		CCar = CBuilt;
+		CCar = cb;
 		if (TSStat == STRM_TSSTAT_WDAT)
 			// The dispatcher is waiting for a car
 			ptrigger (TSender, TSender);
 	}
 
 	NQueued++;
+}
+
+static void add_current () {
+
+	CBuilt -> code = MESSAGE_CODE_SBLOCK;
+	add_block (CBuilt);
 	CBuilt = NULL;
+	SyncBlock = LastGenerated;
 }
 
 #if RETURN_QUEUE_STATUS
@@ -95,7 +297,7 @@ static void fill_current_car (address pkt) {
 	sint i;
 	lword bn = CCar -> bn;
 
-	pkt_osshdr (pkt) -> code = MESSAGE_CODE_SBLOCK;
+	pkt_osshdr (pkt) -> code = CCar -> code;
 	pkt_osshdr (pkt) -> ref = (byte) bn;
 
 	bn >>= 8;
@@ -106,7 +308,7 @@ static void fill_current_car (address pkt) {
 		(bn & 0x3);
 	bn >>= 2;
 
-	for (i = 2; i < STRM_NCODES; i++) {
+	for (i = 2; i < NCodes; i++) {
 		((lword*) pkt_payload (pkt)) [i] =
 			CCar -> block [i] | (bn & 0x3);
 		bn >>= 2;
@@ -120,13 +322,15 @@ static void fill_current_car (address pkt) {
 	sint i;
 	lword bn = CCar -> bn;
 
-	pkt_osshdr (pkt) -> code = MESSAGE_CODE_SBLOCK;
+	pkt_osshdr (pkt) -> code = CCar -> code;
 	// The least significant byte goes into ref; this way the ref field
 	// can be used directly as a modulo-256 block count
 	pkt_osshdr (pkt) -> ref = (byte) bn;
 
 	bn >>= 8;
-	for (i = 0; i < STRM_NCODES; i++) {
+	// Two bits per code; the block number fits the first STRM_NCODES
+	// codes, the bits of the remaining ones (larger cars) are zero
+	for (i = 0; i < NCodes; i++) {
 		((lword*) pkt_payload (pkt)) [i] =
 			CCar -> block [i] | (bn & 0x3);
 		bn >>= 2;
@@ -149,51 +353,219 @@ static void fill_eot (address pkt) {
 	// is below the head), 1 means head == LastSent
 	pay -> voltage = VOLTAGE;
 	pay -> flags = TFlags;
+
+	if (SyncOn && SyncMBlock &&
+	    strm_ticks () - SyncTag < ((lword) STRM_SYNC_AGE << 16)) {
+		// The mapping of our samples to the coordinator's clock; the
+		// difference (in our ticks) is short enough to ignore the drift
+		pay -> sblock = SyncMBlock;
+		pay -> sclock = SyncPeg + (SyncMTime - SyncTag);
+		pay -> sfrac = SyncMFrac;
+		pay -> flags |= STRM_TFLAG_SYN;
+	} else {
+		pay -> sblock = pay -> sclock = 0;
+		pay -> sfrac = 0;
+	}
 #undef pay
+	prof_eot ();
 }
 
+static void train_start () {
+//
+// A new train starts from the head of the queue
+//
+	NCars = 0;
+	CCar = BHead;
+	TSStat = STRM_TSSTAT_NONE;
+	LTrain++;
+	TFlags = 0;
+}
+
+static void train_next () {
+//
+// The current car has been sent
+//
+	prof_car ();
+	// The highest block sent so far: a train cut short (by the end of
+	// the TDMA slot) may only carry retransmissions
+	if (CCar -> bn > LastSent)
+		LastSent = CCar -> bn;
+	CCar = CCar -> next;
+	NCars++;
+}
+
+static void sync_mark (word fill, word per) {
+//
+// All samples taken so far have been read, fill of per in the block being
+// built
+//
+	SyncMBlock = SyncBlock;
+	SyncMFrac = (word)(((lword) fill << 16) / per);
+	SyncMTime = strm_ticks ();
+}
+
+// ============================================================================
+// TDMA: with a coordinator on the channel, trains only go out in our slot;
+// the times are in RTC ticks
+// ============================================================================
+
+static lword	TBeacon,		// Last beacon received
+		TOffset,		// Our slot from the beacon
+		TCycle, TSlot;
+static Boolean	TSlotted;
+
+void streaming_beacon (byte, const address pay, word pl) {
+//
+// A beacon from the coordinator: its clock for the time sync, then find our
+// group in the schedule (the ref is not used)
+//
+	word k, n;
+
+#define	bcn	((const strbcn_t*) pay)
+
+	if (pl < 8)
+		return;
+
+	SyncTag = strm_ticks ();
+	SyncPeg = bcn -> clock;
+	SyncOn = YES;
+
+	if (pl < 10 || bcn -> cycle <= STRM_TDMA_GUARD)
+		// Sync only
+		return;
+
+	n = (pl - 8) / 2;
+	if (n > STRM_TDMA_MAX_SLOTS)
+		n = STRM_TDMA_MAX_SLOTS;
+
+	for (k = 0; k < n; k++)
+		if (bcn -> groups [k] == GROUP_ID)
+			break;
+
+	if (k == n) {
+		// Not scheduled, keep going as before
+		TSlotted = NO;
+		return;
+	}
+
+	TBeacon = SyncTag;
+	TCycle = (lword) bcn -> cycle << 6;
+	TSlot = (lword) bcn -> slot << 6;
+	TOffset = ((lword) STRM_TDMA_GUARD << 6) + TSlot * k;
+	TSlotted = YES;
+#undef	bcn
+}
+
+static lword tdma_phase () {
+//
+// Ticks since the start of our current (or last) slot; beacons missing
+// for STRM_TDMA_LOST cycles end the schedule
+//
+	lword d;
+
+	if ((d = strm_ticks () - TBeacon) >= TCycle * STRM_TDMA_LOST) {
+		TSlotted = NO;
+		return 0;
+	}
+
+	if ((d -= TOffset) & 0x80000000)
+		// Before our first slot after the beacon
+		d += TCycle;
+
+	return d % TCycle;
+}
+
+static word tdma_wait (word tail) {
+//
+// Msecs to wait until we are in our slot (excluding its last tail msecs),
+// zero if we are there (or have no slot)
+//
+	lword p;
+
+	if (!TSlotted)
+		return 0;
+
+	p = tdma_phase ();
+
+	if (!TSlotted || p + ((lword) tail << 6) < TSlot)
+		return 0;
+
+	// Rounded up
+	return (word)((TCycle - p + 63) >> 6);
+}
+
+static word tdma_left (word tail) {
+//
+// Msecs left in our slot (excluding the tail), WNONE if no slot
+//
+	lword p;
+
+	if (!TSlotted)
+		return WNONE;
+
+	p = tdma_phase () + ((lword) tail << 6);
+
+	if (!TSlotted)
+		return WNONE;
+
+	return p >= TSlot ? 0 : (word)((TSlot - p + 63) >> 6);
+}
+
+#ifndef	__HOSTSIM__
+
+// The host harness (HOSTSIM) drives the above functions (and streaming_tack)
+// with its own event loop in place of the FSMs
+
 fsm streaming_trainsender {
 
 	word train_space;
 
 	state ST_NEWTRAIN:
 
-		NCars = 0;
-		CCar = BHead;
-		TSStat = STRM_TSSTAT_NONE;
-		LTrain++;
-		TFlags = 0;
+		train_start ();
 
 	state ST_NEXT:
 
 		address pkt;
+		word w;
 
-		if (NCars >= TagParams.train_length) {
+		w = tdma_wait (STRM_TDMA_TAIL);
+
+		if (NCars >= TRAIN_LENGTH || (NCars && w)) {
+			// Full or at the end of our slot
 			TSStat = STRM_TSSTAT_WACK;
 			train_space = TagParams.min_train_space;
 			sameas ST_ENDTRAIN;
 		}
 
+		if (w) {
+			// The train waits for our slot
+			delay (w, ST_NEXT);
+			release;
+		}
+
 		if (CCar == NULL) {
 			// Wait for event
 			TSStat = STRM_TSSTAT_WDAT;
 			when (TSender, ST_NEXT);
+			if ((w = tdma_left (STRM_TDMA_TAIL)) != WNONE)
+				// Or the end of the slot to close the train
+				delay (w, ST_NEXT);
 			release;
 		}
 
 		TSStat = STRM_TSSTAT_NONE;
 
-		if ((pkt = tcv_wnp (ST_NEXT, RFC, STRM_NCODES * 4 +
+		if ((pkt = tcv_wnp (ST_NEXT, RFC, NCodes * 4 +
 		    PKT_FRAME_ALL)) != NULL) {
 
 			fill_current_car (pkt);
 			// No LBT
 			tcv_endpx (pkt, NO);
+			energy_awake (EN_US_PACKET);
 		}
 
-		LastSent = CCar -> bn;
-		CCar = CCar -> next;
-		NCars++;
+		train_next ();
 
 		delay (TagParams.car_space, ST_NEXT);
 		release;
@@ -201,17 +573,27 @@ fsm streaming_trainsender {
 	state ST_ENDTRAIN:
 
 		address pkt;
+		word w;
 
 		if (TSStat != STRM_TSSTAT_WACK)
 			// The ACK has arrived and has been processed
 			sameas ST_NEWTRAIN;
 
+		if ((w = tdma_wait (STRM_TDMA_ETAIL)) != 0) {
+			// Hold the EOTs until our next slot (the ACK can still
+			// arrive)
+			delay (w, ST_ENDTRAIN);
+			when (TSender, ST_ENDTRAIN);
+			release;
+		}
+
 		// Keep sending EOT packets waiting for an ACK
 		if ((pkt = tcv_wnp (ST_ENDTRAIN, RFC,
 			sizeof (message_etrain_t) + PKT_FRAME_ALL)) != NULL) {
 
 			fill_eot (pkt);
 			tcv_endpx (pkt, NO);
+			energy_awake (EN_US_PACKET);
 		}
 
 		delay (train_space, ST_ENDTRAIN);
@@ -223,22 +605,57 @@ fsm streaming_trainsender {
 #if MPU9250_FIFO_BUFFER_SIZE
 
 // Use FIFO (this doesn't work with LP mode)
-static word sg_delay = 4;
+
+// The polling interval adapts to the number of samples found in the FIFO
+// per wakeup: the interval grows slowly (by 1/8) while the fill is below
+// FIFO_TARGET and is halved when the fill reaches FIFO_HIGH (or the FIFO
+// overflows). There is no watermark interrupt to rely on.
+#define	FIFO_TARGET	(MPU9250_FIFO_CAPACITY / 2)
+#define	FIFO_HIGH	((MPU9250_FIFO_CAPACITY * 3) / 4)
+
+static word sg_delay = 4, sg_max, sg_fill;
 
 static void fifo_start () {
 
 	lword d;
 
-	// Calculate a safe delay
-	d = (1024 * 60 * (MPU9250_FIFO_BUFFER_SIZE/2)) / mpu9250_desc.rate;
+	// The longest delay: the time to reach the target fill
+	d = (1024L * 60 * FIFO_TARGET) / mpu9250_desc.rate;
+	sg_max = d > 1024 ? 1024 : (d == 0 ? 1 : (word) d);
+
+	// Start from a safe delay
+	d = (1024L * 60 * (MPU9250_FIFO_BUFFER_SIZE/2)) / mpu9250_desc.rate;
+	sg_delay = d > sg_max ? sg_max : (d == 0 ? 1 : (word) d);
 
-	sg_delay = d > 1024 ? 1024 : (word) d;
+	sg_fill = 0;
 
-	// diag ("SD: %u", sg_delay);
+	// diag ("SD: %u %u", sg_delay, sg_max);
 
 	mpu9250_fifo_start ();
 }
 
+static void fifo_adjust () {
+//
+// Called when the FIFO has been drained; sg_fill is the number of samples
+// extracted since the wakeup
+//
+	// The wakeup, and the samples it has extracted
+	energy_awake (EN_US_SAMPLE + sg_fill * EN_US_FIFO);
+
+	if (sg_fill > StreamStats . fifo_hwm)
+		StreamStats . fifo_hwm = sg_fill;
+
+	if (sg_fill >= FIFO_HIGH) {
+		if ((sg_delay >>= 1) == 0)
+			sg_delay = 1;
+	} else if (sg_fill < FIFO_TARGET && sg_delay < sg_max) {
+		if ((sg_delay += (sg_delay >> 3) + 1) > sg_max)
+			sg_delay = sg_max;
+	}
+
+	sg_fill = 0;
+}
+
 #define	fifo_stop()	mpu9250_fifo_stop ()
 
 fsm streaming_generator {
@@ -249,8 +666,13 @@ fsm streaming_generator {
 
 		word nw, *dt;
 
+		prof_gen_start ();
 		if ((nw = mpu9250_fifo_get (data, MPU9250_FIFO_BUFFER_SIZE)) ==
 		    0) {
+			// Drained
+			prof_gen_end ();
+			sync_mark (CBuilt ? CFill : 0, NCodes);
+			fifo_adjust ();
 			delay (sg_delay, ST_TAKE);
 			release;
 		}
@@ -258,6 +680,9 @@ fsm streaming_generator {
 		if (nw == MPU9250_FIFO_OVERFLOW) {
 			StreamStats . fifo_overflows ++;
 			TFlags |= STRM_TFLAG_FOV;
+			// Treat as full
+			sg_fill = MPU9250_FIFO_CAPACITY;
+			fifo_adjust ();
 			delay (1, ST_TAKE);
 			release;
 		}
@@ -269,7 +694,7 @@ fsm streaming_generator {
 			if (CBuilt == NULL) {
 				// Next buffer
 				CBuilt =
-				    (strblk_t*) umalloc (sizeof (strblk_t));
+				    (strblk_t*) umalloc (strblk_size (NCodes));
 				if (CBuilt == NULL) {
 					// We have to be smarter than this
 					StreamStats . malloc_failures ++;
@@ -281,8 +706,9 @@ fsm streaming_generator {
 		
 			CBuilt -> block [CFill++] = encode (dt);
 			SamplesTaken++;
+			sg_fill++;
 
-			if (CFill == STRM_NCODES) {
+			if (CFill == NCodes) {
 				// This sets CBuilt to NULL
 				add_current ();
 			}
@@ -291,6 +717,7 @@ fsm streaming_generator {
 			nw -= 3;
 		}
 
+		prof_gen_end ();
 		// Just loop
 		sameas ST_TAKE;
 }
@@ -308,11 +735,12 @@ fsm streaming_generator {
 
 		word data [3];
 
+		prof_gen_start ();
 		read_mpu9250 (WNONE, data);
 
 		if (CBuilt == NULL) {
 			// Next buffer
-			CBuilt = (strblk_t*) umalloc (sizeof (strblk_t));
+			CBuilt = (strblk_t*) umalloc (strblk_size (NCodes));
 			if (CBuilt == NULL) {
 				// We have to be smarter than this
 				StreamStats . malloc_failures ++;
@@ -325,11 +753,15 @@ fsm streaming_generator {
 		CBuilt -> block [CFill++] = encode (data);
 		SamplesTaken++;
 
-		if (CFill == STRM_NCODES) {
+		if (CFill == NCodes) {
 			// This sets CBuilt to NULL and so on
 			add_current ();
 		}
 
+		prof_gen_end ();
+		sync_mark (CBuilt ? CFill : 0, NCodes);
+		energy_awake (EN_US_SAMPLE);
+
 	initial state ST_WAIT:
 
 		ready_mpu9250 (ST_TAKE);
@@ -337,12 +769,72 @@ fsm streaming_generator {
 
 #endif	/* FIFO or no FIFO */
 
+fsm streaming_miclevels {
+//
+// Converts the microphone readings into a stream of levels, one level
+// per MicInterval msecs; the level is the average amplitude over the
+// interval
+//
+	state ST_MTAKE:
+
+		lword data [2];
+		lword lv;
+
+		read_obmicrophone (WNONE, (address) data);
+		obmicrophone_reset ();
+		energy_awake (EN_US_SAMPLE);
+
+		// data [0] == number of samples, data [1] == amplitude sum
+		lv = data [0] ? data [1] / data [0] : 0;
+		if (lv > 0x7fff)
+			lv = 0x7fff;
+
+		if (MBuilt == NULL) {
+			MBuilt = (strblk_t*) umalloc (strblk_size (NCodes));
+			if (MBuilt == NULL) {
+				StreamStats . malloc_failures ++;
+				TFlags |= STRM_TFLAG_MAL;
+				sameas ST_MWAIT;
+			}
+			MBuilt -> code = MESSAGE_CODE_MBLOCK;
+			MFill = 0;
+		}
+
+		// Two levels per code, above the two bits reserved for the
+		// block number
+		if (MFill & 1)
+			MBuilt -> block [MFill >> 1] |= (lv << 2);
+		else
+			MBuilt -> block [MFill >> 1] = (lv << 17);
+
+		if (!(StreamSet & MPU9250_FLAG))
+			// Mic only, count levels as samples
+			SamplesTaken++;
+
+		if (++MFill == MIC_LEVELS) {
+			add_block (MBuilt);
+			MBuilt = NULL;
+			if (!(StreamSet & MPU9250_FLAG))
+				SyncBlock = LastGenerated;
+		}
+
+		if (!(StreamSet & MPU9250_FLAG))
+			// Mic only, the levels are timed
+			sync_mark (MBuilt ? MFill : 0, MIC_LEVELS);
+
+	initial state ST_MWAIT:
+
+		delay (MicInterval, ST_MTAKE);
+}
+
+#endif	/* __HOSTSIM__ */
+
 void streaming_tack (byte ref, byte *ab, word plen) {
 //
 // Process a train ACK
 //
 	strblk_t *cb, *pv, *tm, *ta;
-	lword	nts, boundary;
+	lword	nts;
 	sint	mp;
 	word 	rlen;
 
@@ -352,7 +844,8 @@ void streaming_tack (byte ref, byte *ab, word plen) {
 // Advance the queue pointer
 #define	adv_cb	do { ta = cb; cb = (pv = cb)->next; } while (0)
 // Delete current item
-#define	del_cb	do { tm = cb; cb = cb->next; ufree (tm); NQueued--; \
+#define	del_cb	do { tm = cb; cb = cb->next; prof_release (tm); ufree (tm); \
+		    NQueued--; \
 		    if (pv == NULL) BHead = cb; else pv->next = cb; } while (0)
 // Complete packet queue processing
 #define	end_cb	do { if (cb == NULL) BTail = ta; } while (0)
@@ -363,6 +856,10 @@ void streaming_tack (byte ref, byte *ab, word plen) {
 		return;
 	}
 
+#if STREAM_PROFILE
+	lword t0 = strm_ticks ();
+#endif
+
 	mp = 0;
 	rlen = plen;		// Remaining length
 
@@ -461,7 +958,10 @@ end_ack:
 		del_cb;
 
 	end_cb;
-		
+
+#if STREAM_PROFILE
+	prof_ack (t0);
+#endif
 	TSStat = STRM_TSSTAT_NONE;
 	ptrigger (TSender, TSender);
 #undef	ini_cb
@@ -470,55 +970,101 @@ end_ack:
 #undef	end_cb
 }
 
+#ifndef	__HOSTSIM__
+
 word streaming_start (const command_stream_t *par, word pml) {
 //
-// Assume same request format as for sampling (just the rate for now)
+// Assume same request format as for sampling (just the rate for now);
+// ncodes == 0 selects the default car size
 //
-	word ret;
+	word ret, nc;
 	const byte *buf;
 
 	if (Status == STATUS_SAMPLING)
 		return ACK_BUSY;
 
-	if (pml < 2)
+	if (pml < 4)
+		return ACK_PARAM;
+
+	if ((nc = par->ncodes) == 0)
+		nc = STRM_NCODES;
+	else if (nc < STRM_NCODES || nc > STRM_MAX_NCODES)
 		return ACK_PARAM;
 
 	if (par->confdata.size != 0) {
 		// Full automatic setup
-		if ((ret = sensing_configure (&(par->confdata), pml)) != ACK_OK)
+		if ((ret = sensing_configure (&(par->confdata), pml - 2)) !=
+		    ACK_OK)
 			return ret;
 		// All sensors off
 		sensing_all_off ();
-		// Turn on the IMU
-		sensing_turn (0x81);
+		// Turn on the streamed sensors (the IMU and/or the mic)
+		if ((ret = sensing_stream_set ()) == 0)
+			return ACK_CONFIG;
+		sensing_turn (0x80 | ret);
 	}
 
-	if (!mpu9250_active || mpu9250_desc . components != 1 ||
-	    mpu9250_desc . evtype != 2)
+	ret = 0;
+
+	if (mpu9250_active && mpu9250_desc . components == 1 &&
+	    mpu9250_desc . evtype == 2)
 		// The only legit component is the accel; we expect exactly
-		// 3 values from the sensor
+		// 3 values from the sensor; note that evtype != 2 when the
+		// activity classifier is on (it uses the IMU's data ready)
+		ret |= MPU9250_FLAG;
+
+	if (obmicrophone_active &&
+	    (MicInterval = sensing_mic_interval ()) != 0) {
+		if (MicInterval < OBMICROPHONE_MIN_STREAM)
+			MicInterval = OBMICROPHONE_MIN_STREAM;
+		ret |= OBMICROPHONE_FLAG;
+	}
+
+	if (ret == 0)
+		// Nothing to stream
 		return ACK_CONFIG;
 
 	if (Status == STATUS_STREAMING)
 		// Clear everything; we probably shouldn't be restarting
 		streaming_stop ();
 
+	StreamSet = (byte) ret;
+	NCodes = nc;
 	LastGenerated = SamplesTaken = 0;
-	SamplesPerMinute = mpu9250_desc.rate;
+	SyncBlock = SyncMBlock = 0;
+	SamplesPerMinute = (StreamSet & MPU9250_FLAG) ? mpu9250_desc.rate :
+		(word)((1024L * 60) / MicInterval);
+
+	if (StreamSet & MPU9250_FLAG) {
+		fifo_start ();
+		if (!runfsm streaming_generator)
+			goto Fail;
+	}
+
+	if ((StreamSet & OBMICROPHONE_FLAG) && !runfsm streaming_miclevels)
+		goto Fail;
 
-	fifo_start ();
-	if ((TSender = runfsm streaming_trainsender) &
-	    runfsm streaming_generator) {
+	if ((TSender = runfsm streaming_trainsender)) {
 		Status = STATUS_STREAMING;
 		SamplesTaken = 0;
 		LTrain = 0;
 		bzero (&StreamStats, sizeof (StreamStats));
+#if STREAM_PROFILE
+		bzero (&Prof, sizeof (Prof));
+#endif
 		powerup ();
+		energy_powerup (YES);
+		energy_start ();
 		return ACK_OK;
 	}
 
-	streaming_stop ();
+Fail:
+	// Status is not STATUS_STREAMING yet, so streaming_stop would do
+	// nothing
+	killall (streaming_generator);
+	killall (streaming_miclevels);
 	fifo_stop ();
+	StreamSet = 0;
 	return ACK_NORES;
 }
 
@@ -528,22 +1074,33 @@ void streaming_stop () {
 		return;
 
 	killall (streaming_generator);
+	killall (streaming_miclevels);
 	killall (streaming_trainsender);
-	fifo_stop ();
+	if (StreamSet & MPU9250_FLAG)
+		fifo_stop ();
 
 	if (CBuilt) {
 		ufree (CBuilt);
 		CBuilt = NULL;
 	}
 
+	if (MBuilt) {
+		ufree (MBuilt);
+		MBuilt = NULL;
+	}
+
 	while (BHead)
 		delete_front ();
 
-	NQueued = NCars = CFill = 0;
+	NQueued = NCars = CFill = MFill = 0;
+	StreamSet = 0;
 	TSStat = STRM_TSSTAT_NONE;
 	LTrain = 0;
 	CCar = NULL;
 
 	Status = STATUS_IDLE;
 	powerdown ();
+	energy_powerup (NO);
 }
+
+#endif	/* __HOSTSIM__ */
@@ -18,5 +18,11 @@
 word streaming_start (const command_stream_t*, word);
 void streaming_stop ();
 void streaming_tack (byte, byte*, word);
+void streaming_beacon (byte, const address, word);
+#if STREAM_PROFILE
+word streaming_send_profile (byte);
+#endif
+
+extern byte StreamSet;
 
 #endif
@@ -26,6 +26,11 @@ typedef struct {
 	word		car_space;
 	word		min_train_space;
 	word		byte_error_rate;
+	// Gilbert-Elliott (bursty) loss: the byte error rate in the bad
+	// state and the transition probabilities per packet (times 2^-16)
+	word		byte_error_bad;
+	word		gb_transition;
+	word		bg_transition;
 
 } tag_params_t;
 
@@ -38,6 +43,7 @@ typedef	struct {
 	lword		fifo_overflows;
 	lword		malloc_failures;
 	lword		queue_drops;
+	word		fifo_hwm;	// Max samples drained per wakeup
 
 } stream_stats_t;
 